@@ -727,6 +727,7 @@ static void analyzeDatabase(Parse *pParse, int iDb){
   openStatTable(pParse, iDb, iStatCur, 0, 0);
   iMem = pParse->nMem+1;
   assert( sqlite3SchemaMutexHeld(db, iDb, 0) );
+  sqlite3LazyLoadAll(db, iDb);
   for(k=sqliteHashFirst(&pSchema->tblHash); k; k=sqliteHashNext(k)){
     Table *pTab = (Table*)sqliteHashData(k);
     analyzeOneTable(pParse, pTab, 0, iStatCur, iMem);
@@ -835,6 +836,7 @@ typedef struct analysisInfo analysisInfo;
 struct analysisInfo {
   sqlite3 *db;
   const char *zDatabase;
+  int iDb;
 };
 
 /*
@@ -862,6 +864,10 @@ static int analysisLoader(void *pData, int argc, char **argv, char **NotUsed){
   if( argv==0 || argv[0]==0 || argv[2]==0 ){
     return 0;
   }
+  if( sqlite3LazyStat(pInfo->db, pInfo->iDb, argv) ){
+    /* The table has not been parsed yet. The row is applied once it is. */
+    return 0;
+  }
   pTable = sqlite3FindTable(pInfo->db, argv[0], pInfo->zDatabase);
   if( pTable==0 ){
     return 0;
@@ -891,6 +897,18 @@ static int analysisLoader(void *pData, int argc, char **argv, char **NotUsed){
   return 0;
 }
 
+/*
+** Apply one row of the sqlite_stat1 table of database iDb, as read by
+** sqlite3AnalysisLoad(), to the schema.
+*/
+void sqlite3AnalysisLoadRow(sqlite3 *db, int iDb, char **argv){
+  analysisInfo sInfo;
+  sInfo.db = db;
+  sInfo.zDatabase = db->aDb[iDb].zName;
+  sInfo.iDb = iDb;
+  analysisLoader(&sInfo, 3, argv, 0);
+}
+
 /*
 ** If the Index.aSample variable is not NULL, delete the aSample[] array
 ** and its contents.
@@ -1087,8 +1105,10 @@ int sqlite3AnalysisLoad(sqlite3 *db, int iDb){
   }
 
   /* Check to make sure the sqlite_stat1 table exists */
+  sqlite3LazyStat(db, iDb, 0);
   sInfo.db = db;
   sInfo.zDatabase = db->aDb[iDb].zName;
+  sInfo.iDb = iDb;
   if( sqlite3FindTable(db, "sqlite_stat1", sInfo.zDatabase)==0 ){
     return SQLITE_ERROR;
   }
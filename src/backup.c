@@ -370,6 +370,12 @@ int sqlite3_backup_step(sqlite3_backup *p, int nPage){
       sqlite3BtreeGetMeta(p->pDest, BTREE_SCHEMA_VERSION, &p->iDestSchema);
     }
 
+    /* Pages of the destination are about to be overwritten. Any b-tree
+    ** structure information cached by the destination is now stale. */
+    if( rc==SQLITE_OK ){
+      p->pDest->pBt->iTreeVersion++;
+    }
+
     /* If there is no open read-transaction on the source database, open
     ** one now. If a transaction is opened here, then it will be closed
     ** before this function exits.
@@ -1435,6 +1435,7 @@ static int btreeInitPage(MemPage *pPage){
     assert( pBt->pageSize>=512 && pBt->pageSize<=65536 );
     pPage->maskPage = (u16)(pBt->pageSize - 1);
     pPage->nOverflow = 0;
+    pPage->nAppend = 0;
     usableSize = pBt->usableSize;
     pPage->cellOffset = cellOffset = hdr + 12 - 4*pPage->leaf;
     pPage->aDataEnd = &data[usableSize];
@@ -1545,6 +1546,7 @@ static void zeroPage(MemPage *pPage, int flags){
   pPage->aDataEnd = &data[pBt->usableSize];
   pPage->aCellIdx = &data[first];
   pPage->nOverflow = 0;
+  pPage->nAppend = 0;
   assert( pBt->pageSize>=512 && pBt->pageSize<=65536 );
   pPage->maskPage = (u16)(pBt->pageSize - 1);
   pPage->nCell = 0;
@@ -1706,9 +1708,15 @@ static void pageReinit(DbPage *pData){
 */
 static int btreeInvokeBusyHandler(void *pArg){
   BtShared *pBt = (BtShared*)pArg;
+  BusyHandler *pBusy;
+  int rc;
   assert( pBt->db );
   assert( sqlite3_mutex_held(pBt->db->mutex) );
-  return sqlite3InvokeBusyHandler(&pBt->db->busyHandler);
+  pBusy = &pBt->db->busyHandler;
+  pBusy->pFile = sqlite3PagerFile(pBt->pPager);
+  rc = sqlite3InvokeBusyHandler(pBusy);
+  pBusy->pFile = 0;
+  return rc;
 }
 
 /*
@@ -2105,6 +2113,9 @@ int sqlite3BtreeClose(Btree *p){
     }
     sqlite3DbFree(0, pBt->pSchema);
     freeTempSpace(pBt);
+#ifndef SQLITE_OMIT_AUTOVACUUM
+    sqlite3_free(pBt->pCompact);
+#endif
     sqlite3_free(pBt);
   }
 
@@ -2657,6 +2668,7 @@ int sqlite3BtreeBeginTrans(Btree *p, int wrflag){
   sqlite3 *pBlock = 0;
   BtShared *pBt = p->pBt;
   int rc = SQLITE_OK;
+  int bConcurrent;                /* True for a BEGIN CONCURRENT transaction */
 
   sqlite3BtreeEnter(p);
   btreeIntegrity(p);
@@ -2707,6 +2719,16 @@ int sqlite3BtreeBeginTrans(Btree *p, int wrflag){
   rc = querySharedCacheTableLock(p, MASTER_ROOT, READ_LOCK);
   if( SQLITE_OK!=rc ) goto trans_begun;
 
+  /* If this call opens the read transaction on the main database of a
+  ** connection that has executed BEGIN CONCURRENT, tell the pager. This
+  ** is not done if the shared-cache is in use by other connections.  */
+  bConcurrent = (p->db->bConcurrent && !p->db->autoCommit
+      && pBt->inTransaction==TRANS_NONE && p->db->aDb[0].pBt==p
+  );
+#ifndef SQLITE_OMIT_SHARED_CACHE
+  if( p->sharable && pBt->nRef>1 ) bConcurrent = 0;
+#endif
+
   pBt->btsFlags &= ~BTS_INITIALLY_EMPTY;
   if( pBt->nPage==0 ) pBt->btsFlags |= BTS_INITIALLY_EMPTY;
   do {
@@ -2719,6 +2741,9 @@ int sqlite3BtreeBeginTrans(Btree *p, int wrflag){
     */
     while( pBt->pPage1==0 && SQLITE_OK==(rc = lockBtree(pBt)) );
 
+    if( rc==SQLITE_OK && bConcurrent ){
+      rc = sqlite3PagerBeginConcurrent(pBt->pPager);
+    }
     if( rc==SQLITE_OK && wrflag ){
       if( (pBt->btsFlags & BTS_READ_ONLY)!=0 ){
         rc = SQLITE_READONLY;
@@ -3156,6 +3181,410 @@ int sqlite3BtreeIncrVacuum(Btree *p){
   return rc;
 }
 
+/*
+** The following structure is used by sqlite3BtreeCompact() to record the
+** parent of each b-tree page in the last few pages of a database file that
+** has no pointer-map. Page iFirst+i is a child of page aParent[i], or its
+** parent is unknown if aParent[i] is zero.
+**
+** The map is kept in BtShared.pCompact between calls. It remains valid
+** for as long as BtShared.iTreeVersion and the pager data version are
+** unchanged, that is, until a b-tree is modified other than by
+** sqlite3BtreeCompact() itself, a transaction or savepoint is rolled
+** back, or the page cache is reset.
+*/
+struct CompactMap {
+  Pgno iFirst;            /* First page covered by the map */
+  Pgno nEntry;            /* Number of entries in aParent[] */
+  Pgno *aParent;          /* Parent of each page, or 0 */
+  u32 iTreeVersion;       /* Value of BtShared.iTreeVersion */
+  u32 iDataVersion;       /* Value of sqlite3PagerDataVersion() */
+};
+
+static void compactSetParent(CompactMap *pMap, Pgno iChild, Pgno iParent){
+  if( iChild>=pMap->iFirst && iChild-pMap->iFirst<pMap->nEntry ){
+    pMap->aParent[iChild-pMap->iFirst] = iParent;
+  }
+}
+static Pgno compactGetParent(CompactMap *pMap, Pgno iChild){
+  if( iChild>=pMap->iFirst && iChild-pMap->iFirst<pMap->nEntry ){
+    return pMap->aParent[iChild-pMap->iFirst];
+  }
+  return 0;
+}
+
+/*
+** Record page pPage as the parent of each of its children in pMap. If 
+** nDepth is greater than one, the children are themselves interior pages 
+** and this routine recurses into each of them. Leaf pages are never read.
+*/
+static int compactMapChildren(CompactMap *pMap, MemPage *pPage, int nDepth){
+  int rc = SQLITE_OK;
+  int i;
+  if( pPage->leaf ) return SQLITE_OK;
+  for(i=0; i<=pPage->nCell && rc==SQLITE_OK; i++){
+    Pgno iChild;
+    if( i==pPage->nCell ){
+      iChild = get4byte(&pPage->aData[pPage->hdrOffset+8]);
+    }else{
+      iChild = get4byte(findCell(pPage, i));
+    }
+    compactSetParent(pMap, iChild, pPage->pgno);
+    if( nDepth>1 ){
+      MemPage *pChild;
+      rc = getAndInitPage(pPage->pBt, iChild, &pChild, 0);
+      if( rc==SQLITE_OK ){
+        rc = compactMapChildren(pMap, pChild, nDepth-1);
+        releasePage(pChild);
+      }
+    }
+  }
+  return rc;
+}
+
+/*
+** Populate pMap with the parents of all interior and leaf pages of the
+** b-tree rooted at page iRoot that fall within the range it covers.
+** Only the interior pages of the tree are read.
+*/
+static int compactMapTree(CompactMap *pMap, BtShared *pBt, Pgno iRoot){
+  MemPage *pRoot;
+  MemPage *pPage;
+  int nDepth = 0;
+  int rc;
+
+  rc = getAndInitPage(pBt, iRoot, &pRoot, 0);
+  if( rc!=SQLITE_OK ) return rc;
+
+  /* All leaves of a b-tree are at the same depth. Find out how many
+  ** levels of interior pages there are by following the left-most path. */
+  pPage = pRoot;
+  while( rc==SQLITE_OK && !pPage->leaf ){
+    Pgno iChild;
+    if( pPage->nCell==0 ){
+      iChild = get4byte(&pPage->aData[pPage->hdrOffset+8]);
+    }else{
+      iChild = get4byte(findCell(pPage, 0));
+    }
+    if( pPage!=pRoot ) releasePage(pPage);
+    if( ++nDepth>=BTCURSOR_MAX_DEPTH ){
+      rc = SQLITE_CORRUPT_BKPT;
+    }else{
+      rc = getAndInitPage(pBt, iChild, &pPage, 0);
+    }
+  }
+  if( rc==SQLITE_OK ){
+    if( pPage!=pRoot ) releasePage(pPage);
+    rc = compactMapChildren(pMap, pRoot, nDepth);
+  }
+  releasePage(pRoot);
+  return rc;
+}
+
+/*
+** Move b-tree page iFrom, a child of page iParent, to free page iTo.
+** The page is defragmented as it is moved.
+*/
+static int compactMovePage(
+  BtShared *pBt,          /* The btree */
+  CompactMap *pMap,       /* Parent map to keep up to date */
+  Pgno iFrom,             /* Page to move */
+  Pgno iParent,           /* Parent of page iFrom */
+  Pgno iTo,               /* Free page to move it to */
+  int bTrunk              /* True if iTo is a free-list trunk page */
+){
+  MemPage *pPage;
+  MemPage *pFree;
+  int bNoContent;
+  int rc;
+
+  /* Journal the free page before it is overwritten. As in 
+  ** allocateBtreePage(), the content of a free-list leaf need not be
+  ** preserved unless the page was freed during this transaction. The
+  ** content of a trunk page must always be preserved. */
+  bNoContent = !btreeGetHasContent(pBt, iTo) && !bTrunk;
+  rc = btreeGetPage(pBt, iTo, &pFree, bNoContent, 0);
+  if( rc!=SQLITE_OK ) return rc;
+  rc = sqlite3PagerWrite(pFree->pDbPage);
+  releasePage(pFree);
+  if( rc!=SQLITE_OK ) return rc;
+
+  rc = getAndInitPage(pBt, iFrom, &pPage, 0);
+  if( rc!=SQLITE_OK ) return rc;
+  TRACE(("COMPACT: Moving %d to free page %d (parent %d)\n", 
+      iFrom, iTo, iParent));
+  rc = sqlite3PagerMovepage(pBt->pPager, pPage->pDbPage, iTo, 0);
+  if( rc==SQLITE_OK ){
+    int i;
+    pPage->pgno = iTo;
+    compactSetParent(pMap, iTo, iParent);
+    for(i=0; !pPage->leaf && i<=pPage->nCell; i++){
+      Pgno iChild;
+      if( i==pPage->nCell ){
+        iChild = get4byte(&pPage->aData[pPage->hdrOffset+8]);
+      }else{
+        iChild = get4byte(findCell(pPage, i));
+      }
+      compactSetParent(pMap, iChild, iTo);
+    }
+    if( pPage->aData[pPage->hdrOffset+7]
+     || get2byte(&pPage->aData[pPage->hdrOffset+1])
+    ){
+      rc = sqlite3PagerWrite(pPage->pDbPage);
+      if( rc==SQLITE_OK ){
+        rc = defragmentPage(pPage);
+      }
+    }
+  }
+  releasePage(pPage);
+
+  if( rc==SQLITE_OK ){
+    MemPage *pParent;
+    rc = btreeGetPage(pBt, iParent, &pParent, 0, 0);
+    if( rc!=SQLITE_OK ) return rc;
+    rc = sqlite3PagerWrite(pParent->pDbPage);
+    if( rc==SQLITE_OK ){
+      rc = modifyPagePointer(pParent, iFrom, iTo, PTRMAP_BTREE);
+    }
+    releasePage(pParent);
+  }
+  return rc;
+}
+
+/*
+** Rewrite the free-list so that it contains exactly those pages that are
+** set in pFree and lie in the range (iAfter, nPage]. Any page that was a 
+** trunk of the old free-list (those set in pTrunk) and becomes a leaf of
+** the new one is flagged in BtShared.pHasContent, as freePage2() does.
+*/
+static int compactFreelist(
+  BtShared *pBt,          /* The btree */
+  Bitvec *pFree,          /* All pages on the old free-list */
+  Bitvec *pTrunk,         /* Trunk pages of the old free-list */
+  Pgno iAfter,            /* Pages up to and including this one are in use */
+  Pgno nPage              /* New size of the database in pages */
+){
+  MemPage *pPage1 = pBt->pPage1;
+  MemPage *pTrunkPg = 0;
+  u32 nMaxLeaf = pBt->usableSize/4 - 8;
+  u32 nLeaf = 0;
+  u32 nTotal = 0;
+  Pgno iHead = 0;
+  Pgno i;
+  int rc;
+
+  rc = sqlite3PagerWrite(pPage1->pDbPage);
+  for(i=nPage; rc==SQLITE_OK && i>iAfter; i--){
+    if( !sqlite3BitvecTest(pFree, i) ) continue;
+    nTotal++;
+    if( pTrunkPg && nLeaf<nMaxLeaf ){
+      put4byte(&pTrunkPg->aData[8+nLeaf*4], i);
+      nLeaf++;
+      if( sqlite3BitvecTest(pTrunk, i) ){
+        rc = btreeSetHasContent(pBt, i);
+      }
+      continue;
+    }
+    if( pTrunkPg ){
+      put4byte(&pTrunkPg->aData[4], nLeaf);
+      releasePage(pTrunkPg);
+      pTrunkPg = 0;
+    }
+    rc = btreeGetPage(pBt, i, &pTrunkPg, 0, 0);
+    if( rc==SQLITE_OK ){
+      rc = sqlite3PagerWrite(pTrunkPg->pDbPage);
+      if( rc==SQLITE_OK ){
+        put4byte(pTrunkPg->aData, iHead);
+        put4byte(&pTrunkPg->aData[4], 0);
+        nLeaf = 0;
+        iHead = i;
+      }else{
+        releasePage(pTrunkPg);
+        pTrunkPg = 0;
+      }
+    }
+  }
+  if( pTrunkPg ){
+    put4byte(&pTrunkPg->aData[4], nLeaf);
+    releasePage(pTrunkPg);
+  }
+  if( rc==SQLITE_OK ){
+    put4byte(&pPage1->aData[32], iHead);
+    put4byte(&pPage1->aData[36], nTotal);
+  }
+  return rc;
+}
+
+/*
+** A write-transaction must be opened before calling this function.
+**
+** Shrink the database file by up to nMax pages by moving the b-tree pages
+** at the end of the file into free pages nearer its start, then truncating
+** it. For an auto-vacuum database this is the same as nMax calls to
+** sqlite3BtreeIncrVacuum(). Otherwise, there is no pointer-map to say
+** which page refers to each page that must be moved, so the interior pages
+** of each b-tree rooted at a page in aRoot[] are scanned to find out.
+** The leaves of the b-trees are not read, but overflow pages are not found
+** either. The database is only truncated as far as the last overflow page
+** or b-tree root page in the file, as these cannot be moved.
+**
+** Because the work is bounded by nMax, the caller may shrink a large 
+** database in a series of short write transactions. The parents found by
+** the first call cover all the pages that later calls may move, so they
+** are saved for those calls (see CompactMap).
+*/
+int sqlite3BtreeCompact(Btree *p, int *aRoot, int nRoot, int nMax){
+  BtShared *pBt = p->pBt;
+  MemPage *pPage1 = pBt->pPage1;
+  Bitvec *pFree = 0;              /* Pages on the free-list */
+  Bitvec *pTrunk = 0;             /* Free-list trunk pages */
+  CompactMap *pMap = 0;           /* Parents of pages near the end of file */
+  Pgno nOrig;                     /* Size of database before compaction */
+  Pgno nFree;                     /* Number of pages on the free-list */
+  Pgno nTail;                     /* Number of pages to map */
+  Pgno iLast;                     /* Last page still in the file */
+  Pgno iDest = 1;                 /* Last free page considered for reuse */
+  Pgno iUsed = 1;                 /* Last free page reused */
+  Pgno iTrunk;
+  Pgno n = 0;
+  int i;
+  int rc = SQLITE_OK;
+
+  sqlite3BtreeEnter(p);
+  assert( pBt->inTransaction==TRANS_WRITE && p->inTrans==TRANS_WRITE );
+  if( pBt->autoVacuum ){
+    for(i=0; i<nMax && rc==SQLITE_OK; i++){
+      rc = sqlite3BtreeIncrVacuum(p);
+    }
+    if( rc==SQLITE_DONE ) rc = SQLITE_OK;
+    goto compact_out;
+  }
+
+  nOrig = btreePagecount(pBt);
+  nFree = get4byte(&pPage1->aData[36]);
+  if( nFree==0 || nMax<=0 ) goto compact_out;
+  if( nFree>=nOrig ){
+    rc = SQLITE_CORRUPT_BKPT;
+    goto compact_out;
+  }
+
+  /* Load the free-list. */
+  pFree = sqlite3BitvecCreate(nOrig);
+  pTrunk = sqlite3BitvecCreate(nOrig);
+  if( pFree==0 || pTrunk==0 ){
+    rc = SQLITE_NOMEM;
+    goto compact_out;
+  }
+  iTrunk = get4byte(&pPage1->aData[32]);
+  while( iTrunk && rc==SQLITE_OK ){
+    MemPage *pPg;
+    u32 k;
+    if( iTrunk<2 || iTrunk>nOrig || sqlite3BitvecTest(pFree, iTrunk) ){
+      rc = SQLITE_CORRUPT_BKPT;
+      break;
+    }
+    rc = btreeGetPage(pBt, iTrunk, &pPg, 0, 0);
+    if( rc!=SQLITE_OK ) break;
+    k = get4byte(&pPg->aData[4]);
+    if( k>pBt->usableSize/4-2 ){
+      rc = SQLITE_CORRUPT_BKPT;
+    }
+    if( rc==SQLITE_OK ) rc = sqlite3BitvecSet(pFree, iTrunk);
+    if( rc==SQLITE_OK ) rc = sqlite3BitvecSet(pTrunk, iTrunk);
+    n++;
+    for(i=0; rc==SQLITE_OK && i<(int)k; i++){
+      Pgno iLeaf = get4byte(&pPg->aData[8+i*4]);
+      if( iLeaf<2 || iLeaf>nOrig || sqlite3BitvecTest(pFree, iLeaf) ){
+        rc = SQLITE_CORRUPT_BKPT;
+      }else{
+        rc = sqlite3BitvecSet(pFree, iLeaf);
+        n++;
+      }
+    }
+    iTrunk = get4byte(pPg->aData);
+    releasePage(pPg);
+  }
+  if( rc==SQLITE_OK && n!=nFree ){
+    rc = SQLITE_CORRUPT_BKPT;
+  }
+  if( rc!=SQLITE_OK ) goto compact_out;
+
+  /* Find the parents of the pages that might be moved. No page before the
+  ** last nFree+1 can be moved by this or any later call, as the file only 
+  ** shrinks by the number of free pages. So if the map saved by an earlier
+  ** call is still valid, it covers all pages that need to be moved. */
+  nTail = nFree + 1;
+  if( nTail>=nOrig ) nTail = nOrig-1;
+  pMap = pBt->pCompact;
+  if( pMap && (pMap->iTreeVersion!=pBt->iTreeVersion
+            || pMap->iDataVersion!=sqlite3PagerDataVersion(pBt->pPager)
+            || pMap->iFirst>nOrig-nTail+1
+            || pMap->iFirst+pMap->nEntry<=nOrig)
+  ){
+    sqlite3_free(pMap);
+    pMap = pBt->pCompact = 0;
+  }
+  if( pMap==0 ){
+    pMap = (CompactMap*)sqlite3MallocZero(sizeof(*pMap)+sizeof(Pgno)*nTail);
+    if( pMap==0 ){
+      rc = SQLITE_NOMEM;
+      goto compact_out;
+    }
+    pMap->iFirst = nOrig - nTail + 1;
+    pMap->nEntry = nTail;
+    pMap->aParent = (Pgno*)&pMap[1];
+    pBt->pCompact = pMap;
+    for(i=0; i<nRoot && rc==SQLITE_OK; i++){
+      if( aRoot[i]>0 ) rc = compactMapTree(pMap, pBt, (Pgno)aRoot[i]);
+    }
+  }
+  if( rc==SQLITE_OK ){
+    rc = saveAllCursors(pBt, 0, 0);
+    invalidateAllOverflowCache(pBt);
+  }
+
+  /* Working backwards from the end of the file, drop free pages and move
+  ** b-tree pages into the lowest numbered free pages. Stop on reaching 
+  ** a free page that has been reused. */
+  for(iLast=nOrig; rc==SQLITE_OK && iLast>iUsed && nOrig-iLast<(Pgno)nMax;
+      iLast--){
+    Pgno iParent;
+    if( iLast==PENDING_BYTE_PAGE(pBt) || sqlite3BitvecTest(pFree, iLast) ){
+      continue;
+    }
+    iParent = compactGetParent(pMap, iLast);
+    if( iParent==0 ) break;
+    do{ iDest++; }while( iDest<iLast && !sqlite3BitvecTest(pFree, iDest) );
+    if( iDest>=iLast ) break;
+    rc = compactMovePage(pBt, pMap, iLast, iParent, iDest,
+                         sqlite3BitvecTest(pTrunk, iDest));
+    iUsed = iDest;
+  }
+  if( iLast==PENDING_BYTE_PAGE(pBt) ) iLast--;
+
+  if( rc==SQLITE_OK && iLast<nOrig ){
+    rc = compactFreelist(pBt, pFree, pTrunk, iUsed, iLast);
+    if( rc==SQLITE_OK ){
+      pBt->bDoTruncate = 1;
+      pBt->nPage = iLast;
+      put4byte(&pPage1->aData[28], iLast);
+    }
+  }
+
+compact_out:
+  if( rc!=SQLITE_OK ){
+    sqlite3_free(pBt->pCompact);
+    pBt->pCompact = 0;
+  }else if( pMap ){
+    pMap->iTreeVersion = pBt->iTreeVersion;
+    pMap->iDataVersion = sqlite3PagerDataVersion(pBt->pPager);
+  }
+  sqlite3BitvecDestroy(pFree);
+  sqlite3BitvecDestroy(pTrunk);
+  sqlite3BtreeLeave(p);
+  return rc;
+}
+
 /*
 ** This routine is called prior to sqlite3PagerCommit when a transaction
 ** is commited for an auto-vacuum database.
@@ -3423,6 +3852,7 @@ int sqlite3BtreeRollback(Btree *p, int tripCode){
   MemPage *pPage1;
 
   sqlite3BtreeEnter(p);
+  pBt->iTreeVersion++;
   if( tripCode==SQLITE_OK ){
     rc = tripCode = saveAllCursors(pBt, 0, 0);
   }else{
@@ -3519,6 +3949,7 @@ int sqlite3BtreeSavepoint(Btree *p, int op, int iSavepoint){
     assert( op==SAVEPOINT_RELEASE || op==SAVEPOINT_ROLLBACK );
     assert( iSavepoint>=0 || (iSavepoint==-1 && op==SAVEPOINT_ROLLBACK) );
     sqlite3BtreeEnter(p);
+    if( op==SAVEPOINT_ROLLBACK ) pBt->iTreeVersion++;
     rc = sqlite3PagerSavepoint(pBt->pPager, op, iSavepoint);
     if( rc==SQLITE_OK ){
       if( iSavepoint<0 && (pBt->btsFlags & BTS_INITIALLY_EMPTY)!=0 ){
@@ -4619,6 +5050,31 @@ int sqlite3BtreeMovetoUnpacked(
     }
   }
 
+  /* If the cursor is pointing to the last entry of an index b-tree and
+  ** that entry is smaller than the key being sought, then the key belongs
+  ** at the end of the b-tree and the cursor is already in the right place.
+  ** This avoids a descent from the root when index entries are inserted
+  ** in ascending order. Only cells stored entirely on the leaf page are
+  ** considered here; anything else is handled by the general case below.  */
+  if( pCur->eState==CURSOR_VALID && pCur->atLast && pIdxKey ){
+    MemPage *pPage = pCur->apPage[pCur->iPage];
+    u8 *pCell = findCell(pPage, pCur->aiIdx[pCur->iPage]);
+    int nCell = pCell[0];
+    int c = 0;
+    assert( pPage->leaf && pPage->childPtrSize==0 );
+    if( nCell<=pPage->max1bytePayload ){
+      c = sqlite3VdbeRecordCompare(nCell, (void*)&pCell[1], pIdxKey);
+    }else if( !(pCell[1] & 0x80) 
+      && (nCell = ((nCell&0x7f)<<7) + pCell[1])<=pPage->maxLocal
+    ){
+      c = sqlite3VdbeRecordCompare(nCell, (void*)&pCell[2], pIdxKey);
+    }
+    if( c<0 ){
+      *pRes = -1;
+      return SQLITE_OK;
+    }
+  }
+
   rc = moveToRoot(pCur);
   if( rc ){
     return rc;
@@ -4960,6 +5416,7 @@ static int allocateBtreePage(
   Pgno mxPage;     /* Total size of the database file */
 
   assert( sqlite3_mutex_held(pBt->mutex) );
+  pBt->iTreeVersion++;
   assert( eMode==BTALLOC_ANY || (nearby>0 && IfNotOmitAV(pBt->autoVacuum)) );
   pPage1 = pBt->pPage1;
   mxPage = btreePagecount(pBt);
@@ -5273,6 +5730,7 @@ static int freePage2(BtShared *pBt, MemPage *pMemPage, Pgno iPage){
   assert( sqlite3_mutex_held(pBt->mutex) );
   assert( iPage>1 );
   assert( !pMemPage || pMemPage->pgno==iPage );
+  pBt->iTreeVersion++;
 
   if( pMemPage ){
     pPage = pMemPage;
@@ -5882,6 +6340,7 @@ static int balance_quick(MemPage *pParent, MemPage *pPage, u8 *pSpace){
     assert( pPage->aData[0]==(PTF_INTKEY|PTF_LEAFDATA|PTF_LEAF) );
     zeroPage(pNew, PTF_INTKEY|PTF_LEAFDATA|PTF_LEAF);
     assemblePage(pNew, 1, &pCell, &szCell);
+    pNew->nAppend = 1;
 
     /* If this is an auto-vacuum database, update the pointer map
     ** with entries for the new page, and any pointer from the 
@@ -6379,6 +6838,58 @@ static int balance_nonroot(
     szNew[i-1] = szLeft;
   }
 
+  /*
+  ** In an index b-tree each divider is a complete entry that moves up
+  ** into the parent page. Where keys differ in length, shifting a
+  ** boundary by a few cells often finds a much smaller divider, which
+  ** raises the fan-out of the interior pages. Accept any boundary within
+  ** usableSpace/8 bytes of the balanced one and use the smallest divider,
+  ** preferring the nearest when sizes are equal.
+  */
+  if( !leafData && !bBulk ){
+    const int nSlack = usableSpace/8;
+    for(i=1; i<k; i++){
+      int iDiv = cntNew[i-1];              /* Divider chosen above */
+      int iLo = (i>1 ? cntNew[i-2]+1 : 0) + 1;
+      int iHi = cntNew[i] - 2;
+      int iBest = iDiv;
+      int szLeft, szRight;                 /* Sibling sizes for candidate d */
+      int d;
+
+      for(d=iDiv, szLeft=szNew[i-1], szRight=szNew[i]; d>iLo; ){
+        szLeft -= szCell[d-1] + 2;
+        szRight += szCell[d] + 2;
+        d--;
+        if( szNew[i-1]-szLeft>nSlack || szRight>usableSpace ) break;
+        if( szCell[d]<szCell[iBest] ) iBest = d;
+      }
+      for(d=iDiv, szLeft=szNew[i-1], szRight=szNew[i]; d<iHi; ){
+        szLeft += szCell[d] + 2;
+        szRight -= szCell[d+1] + 2;
+        d++;
+        if( szLeft-szNew[i-1]>nSlack || szLeft>usableSpace ) break;
+        if( szCell[d]<szCell[iBest]
+         || (szCell[d]==szCell[iBest] && d-iDiv<iDiv-iBest)
+        ){
+          iBest = d;
+        }
+      }
+
+      /* Move the boundary to iBest, recomputing the two sibling sizes */
+      while( iDiv>iBest ){
+        szNew[i-1] -= szCell[iDiv-1] + 2;
+        szNew[i] += szCell[iDiv] + 2;
+        iDiv--;
+      }
+      while( iDiv<iBest ){
+        szNew[i-1] += szCell[iDiv] + 2;
+        szNew[i] -= szCell[iDiv+1] + 2;
+        iDiv++;
+      }
+      cntNew[i-1] = iDiv;
+    }
+  }
+
   /* Either we found one or more cells (cntnew[0])>0) or pPage is
   ** a virtual root page.  A virtual root page is when the real root
   ** page is page 1 and we are the only child of that page.
@@ -6493,6 +7004,12 @@ static int balance_nonroot(
     assemblePage(pNew, cntNew[i]-j, &apCell[j], &szCell[j]);
     assert( pNew->nCell>0 || (nNew==1 && cntNew[0]==0) );
     assert( pNew->nOverflow==0 );
+    if( bBulk && i==nNew-1 ){
+      /* Cells are being appended to the b-tree in order. Let the new
+      ** right-most sibling inherit the run of appends, so that the next
+      ** time it overflows it is split the same way (see balance()). */
+      pNew->nAppend = 1;
+    }
 
     j = cntNew[i];
 
@@ -6777,6 +7294,21 @@ static int balance_deeper(MemPage *pRoot, MemPage **ppChild){
   return SQLITE_OK;
 }
 
+/*
+** Return true if the page that pCur points to overflowed because a
+** single cell was added to the end of it, and the insert before that
+** one also added a cell to the end of the same page. In other words,
+** return true if the caller appears to be inserting keys in ascending
+** order.
+*/
+static int cursorIsAppending(BtCursor *pCur){
+  MemPage *pPage = pCur->apPage[pCur->iPage];
+  return pPage->leaf
+      && pPage->nAppend>1
+      && pPage->nOverflow==1
+      && pPage->aiOvfl[0]==pPage->nCell;
+}
+
 /*
 ** The page that pCur currently points to has just been modified in
 ** some way. This function figures out if this modification means the
@@ -6786,16 +7318,25 @@ static int balance_deeper(MemPage *pRoot, MemPage **ppChild){
 **   balance_quick()
 **   balance_deeper()
 **   balance_nonroot()
+**
+** If the modification was one of a run of appends to a leaf page that
+** is the right-most child of its parent, the caller is inserting keys
+** in ascending order. In that case balance_nonroot() is asked to leave
+** the existing siblings full and to move only the overflow onto a new
+** right-most page (a 100/0 split instead of an even one), so that
+** append-only b-trees are packed densely.
 */
 static int balance(BtCursor *pCur){
   int rc = SQLITE_OK;
   const int nMin = pCur->pBt->usableSize * 2 / 3;
+  const int bAppend = cursorIsAppending(pCur);
   u8 aBalanceQuickSpace[13];
   u8 *pFree = 0;
 
   TESTONLY( int balance_quick_called = 0 );
   TESTONLY( int balance_deeper_called = 0 );
 
+  pCur->pBt->iTreeVersion++;
   do {
     int iPage = pCur->iPage;
     MemPage *pPage = pCur->apPage[iPage];
@@ -6818,7 +7359,13 @@ static int balance(BtCursor *pCur){
       }else{
         break;
       }
-    }else if( pPage->nOverflow==0 && pPage->nFree<=nMin ){
+    }else if( pPage->nOverflow==0 && (pPage->nFree<=nMin
+           || (bAppend && pCur->aiIdx[iPage-1]==pCur->apPage[iPage-1]->nCell))
+    ){
+      /* Either the page is not underfull, or it is an underfull right-most
+      ** page during a run of appends. The latter was started by a 100/0
+      ** split and will be filled by the appends that follow. Balancing it
+      ** with its siblings would undo the 100/0 split.  */
       break;
     }else{
       MemPage * const pParent = pCur->apPage[iPage-1];
@@ -6869,7 +7416,16 @@ static int balance(BtCursor *pCur){
           ** pSpace buffer passed to the latter call to balance_nonroot().
           */
           u8 *pSpace = sqlite3PageMalloc(pCur->pBt->pageSize);
-          rc = balance_nonroot(pParent, iIdx, pSpace, iPage==1, pCur->hints);
+          int bBulk = pCur->hints;
+          if( bAppend
+           && pPage->nOverflow==1
+           && pPage->aiOvfl[0]==pPage->nCell
+           && pParent->nOverflow==0
+           && pParent->nCell==iIdx
+          ){
+            bBulk = 1;
+          }
+          rc = balance_nonroot(pParent, iIdx, pSpace, iPage==1, bBulk);
           if( pFree ){
             /* If pFree is not NULL, it points to the pSpace buffer used 
             ** by a previous call to balance_nonroot(). Its contents are
@@ -7021,6 +7577,13 @@ int sqlite3BtreeInsert(
   }else{
     assert( pPage->leaf );
   }
+  if( pPage->leaf ){
+    if( loc==0 || idx<pPage->nCell ){
+      pPage->nAppend = 0;
+    }else if( pPage->nAppend<0xff ){
+      pPage->nAppend++;
+    }
+  }
   insertCell(pPage, idx, newCell, szNew, 0, 0, &rc);
   assert( rc!=SQLITE_OK || pPage->nCell>0 || pPage->nOverflow>0 );
 
@@ -7046,6 +7609,24 @@ int sqlite3BtreeInsert(
   */
   pCur->info.nSize = 0;
   pCur->validNKey = 0;
+  if( rc==SQLITE_OK && pPage->nOverflow==0 && pPage->leaf ){
+    /* The new cell fit on the leaf page and the cursor points at it. If
+    ** it is the last entry in the b-tree, say so, so that the next insert
+    ** of a larger key can skip the descent from the root page in
+    ** sqlite3BtreeMovetoUnpacked(). This is what makes appending rows
+    ** in ascending key order cheap.  */
+    if( pPage->intKey ){
+      pCur->info.nKey = nKey;
+      pCur->validNKey = 1;
+    }
+    if( idx==pPage->nCell-1 ){
+      int i;
+      for(i=0; i<pCur->iPage && pCur->aiIdx[i]==pCur->apPage[i]->nCell; i++);
+      pCur->atLast = (i==pCur->iPage);
+    }else{
+      pCur->atLast = 0;
+    }
+  }
   if( rc==SQLITE_OK && pPage->nOverflow ){
     rc = balance(pCur);
 
@@ -97,6 +97,7 @@ const char *sqlite3BtreeGetJournalname(Btree *);
 int sqlite3BtreeCopyFile(Btree *, Btree *);
 
 int sqlite3BtreeIncrVacuum(Btree *);
+int sqlite3BtreeCompact(Btree*, int *aRoot, int nRoot, int nMax);
 
 /* The flags parameter to sqlite3BtreeCreateTable can be the bitwise OR
 ** of the flags shown below.
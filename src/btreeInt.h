@@ -230,6 +230,7 @@
 /* Forward declarations */
 typedef struct MemPage MemPage;
 typedef struct BtLock BtLock;
+typedef struct CompactMap CompactMap;
 
 /*
 ** This is a magic string that appears at the beginning of every
@@ -278,6 +279,7 @@ struct MemPage {
   u8 hdrOffset;        /* 100 for page 1.  0 otherwise */
   u8 childPtrSize;     /* 0 if leaf==1.  4 if leaf==0 */
   u8 max1bytePayload;  /* min(maxLocal,127) */
+  u8 nAppend;          /* Consecutive inserts at the end of this page */
   u16 maxLocal;        /* Copy of BtShared.maxLocal or BtShared.maxLeaf */
   u16 minLocal;        /* Copy of BtShared.minLocal or BtShared.minLeaf */
   u16 cellOffset;      /* Index in aData of first cell pointer */
@@ -435,6 +437,10 @@ struct BtShared {
   Btree *pWriter;       /* Btree with currently open write transaction */
 #endif
   u8 *pTmpSpace;        /* BtShared.pageSize bytes of space for tmp use */
+  u32 iTreeVersion;     /* Incremented when b-tree pages may be relinked */
+#ifndef SQLITE_OMIT_AUTOVACUUM
+  CompactMap *pCompact; /* Parent map saved by sqlite3BtreeCompact() */
+#endif
 };
 
 /*
@@ -278,6 +278,9 @@ Table *sqlite3FindTable(sqlite3 *db, const char *zName, const char *zDatabase){
     if( zDatabase!=0 && sqlite3StrICmp(zDatabase, db->aDb[j].zName) ) continue;
     assert( sqlite3SchemaMutexHeld(db, j, 0) );
     p = sqlite3HashFind(&db->aDb[j].pSchema->tblHash, zName, nName);
+    if( p==0 && sqlite3LazyLoad(db, j, zName) ){
+      p = sqlite3HashFind(&db->aDb[j].pSchema->tblHash, zName, nName);
+    }
     if( p ) break;
   }
   return p;
@@ -370,6 +373,9 @@ Index *sqlite3FindIndex(sqlite3 *db, const char *zName, const char *zDb){
     if( zDb && sqlite3StrICmp(zDb, db->aDb[j].zName) ) continue;
     assert( sqlite3SchemaMutexHeld(db, j, 0) );
     p = sqlite3HashFind(&pSchema->idxHash, zName, nName);
+    if( p==0 && sqlite3LazyLoadObject(db, j, zName) ){
+      p = sqlite3HashFind(&pSchema->idxHash, zName, nName);
+    }
     if( p ) break;
   }
   return p;
@@ -1922,6 +1928,7 @@ void sqlite3RootPageMoved(sqlite3 *db, int iDb, int iFrom, int iTo){
   Db *pDb;
 
   assert( sqlite3SchemaMutexHeld(db, iDb, 0) );
+  sqlite3LazyRootPageMoved(db, iDb, iFrom);
   pDb = &db->aDb[iDb];
   pHash = &pDb->pSchema->tblHash;
   for(pElem=sqliteHashFirst(pHash); pElem; pElem=sqliteHashNext(pElem)){
@@ -3427,13 +3434,13 @@ void sqlite3BeginTransaction(Parse *pParse, int type){
   }
   v = sqlite3GetVdbe(pParse);
   if( !v ) return;
-  if( type!=TK_DEFERRED ){
+  if( type!=TK_DEFERRED && type!=TK_CONCURRENT ){
     for(i=0; i<db->nDb; i++){
       sqlite3VdbeAddOp2(v, OP_Transaction, i, (type==TK_EXCLUSIVE)+1);
       sqlite3VdbeUsesBtree(v, i);
     }
   }
-  sqlite3VdbeAddOp2(v, OP_AutoCommit, 0, 0);
+  sqlite3VdbeAddOp3(v, OP_AutoCommit, 0, 0, type==TK_CONCURRENT);
 }
 
 /*
@@ -3722,6 +3729,7 @@ static void reindexDatabases(Parse *pParse, char const *zColl){
   assert( sqlite3BtreeHoldsAllMutexes(db) );  /* Needed for schema access */
   for(iDb=0, pDb=db->aDb; iDb<db->nDb; iDb++, pDb++){
     assert( pDb!=0 );
+    sqlite3LazyLoadAll(db, iDb);
     for(k=sqliteHashFirst(&pDb->pSchema->tblHash);  k; k=sqliteHashNext(k)){
       pTab = (Table*)sqliteHashData(k);
       reindexTable(pParse, pTab, zColl);
@@ -3769,6 +3777,12 @@ void sqlite3Reindex(Parse *pParse, Token *pName1, Token *pName2){
     zColl = sqlite3NameFromToken(pParse->db, pName1);
     if( !zColl ) return;
     pColl = sqlite3FindCollSeq(db, ENC(db), zColl, 0);
+    if( pColl==0 && (db->flags & SQLITE_LazySchema) ){
+      /* The collation sequence may be used only by indexes that have not
+      ** been parsed yet. */
+      for(iDb=0; iDb<db->nDb; iDb++) sqlite3LazyLoadAll(db, iDb);
+      pColl = sqlite3FindCollSeq(db, ENC(db), zColl, 0);
+    }
     if( pColl ){
       reindexDatabases(pParse, zColl);
       sqlite3DbFree(db, zColl);
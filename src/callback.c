@@ -447,6 +447,7 @@ void sqlite3SchemaClear(void *p){
   }
   sqlite3HashClear(&temp1);
   sqlite3HashClear(&pSchema->fkeyHash);
+  sqlite3LazyClear(pSchema);
   pSchema->pSeqTab = 0;
   if( pSchema->flags & DB_SchemaLoaded ){
     pSchema->iGeneration++;
@@ -472,6 +473,9 @@ Schema *sqlite3SchemaGet(sqlite3 *db, Btree *pBt){
     sqlite3HashInit(&p->idxHash);
     sqlite3HashInit(&p->trigHash);
     sqlite3HashInit(&p->fkeyHash);
+    sqlite3HashInit(&p->lazyHash);
+    sqlite3HashInit(&p->lazyObjHash);
+    sqlite3HashInit(&p->lazyStatHash);
     p->enc = SQLITE_UTF8;
   }
   return p;
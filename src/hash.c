@@ -50,88 +50,87 @@ void sqlite3HashClear(Hash *pH){
 }
 
 /*
-** The hashing function.
+** The hashing function. Upper and lower case characters hash to the
+** same value. Every character is mixed into all bits of the result,
+** as the low-order bits alone select the slot in the hash table.
 */
 static unsigned int strHash(const char *z, int nKey){
-  int h = 0;
+  unsigned int h = 0;
   assert( nKey>=0 );
   while( nKey > 0  ){
-    h = (h<<3) ^ h ^ sqlite3UpperToLower[(unsigned char)*z++];
+    h = (h ^ sqlite3UpperToLower[(unsigned char)*z++]) * 0x9e3779b1;
     nKey--;
   }
-  return h;
+  return h ^ (h>>16);
 }
 
+/*
+** The hash table is allocated once the hash contains HASH_MIN_COUNT
+** elements. Before that, lookups are done by a linear search of the list
+** of all elements. HASH_MIN_SIZE is the initial number of slots, which
+** must be a power of two.
+*/
+#define HASH_MIN_COUNT 10
+#define HASH_MIN_SIZE  32
 
-/* Link pNew element into the hash table pH.  If pEntry!=0 then also
-** insert pNew into the pEntry hash bucket.
+/* Link pNew element into the head of the list of all elements of the
+** hash pH. If pH has a hash table, also store pNew in the first free
+** slot at or after the slot selected by its hash.
 */
-static void insertElement(
-  Hash *pH,              /* The complete hash table */
-  struct _ht *pEntry,    /* The entry into which pNew is inserted */
-  HashElem *pNew         /* The element to be inserted */
-){
-  HashElem *pHead;       /* First element already in pEntry */
-  if( pEntry ){
-    pHead = pEntry->count ? pEntry->chain : 0;
-    pEntry->count++;
-    pEntry->chain = pNew;
-  }else{
-    pHead = 0;
-  }
-  if( pHead ){
-    pNew->next = pHead;
-    pNew->prev = pHead->prev;
-    if( pHead->prev ){ pHead->prev->next = pNew; }
-    else             { pH->first = pNew; }
-    pHead->prev = pNew;
-  }else{
-    pNew->next = pH->first;
-    if( pH->first ){ pH->first->prev = pNew; }
-    pNew->prev = 0;
-    pH->first = pNew;
+static void insertElement(Hash *pH, HashElem *pNew){
+  pNew->next = pH->first;
+  if( pH->first ){ pH->first->prev = pNew; }
+  pNew->prev = 0;
+  pH->first = pNew;
+  if( pH->ht ){
+    unsigned int mask = pH->htsize - 1;
+    unsigned int i = pNew->h & mask;
+    while( pH->ht[i].elem ){
+      i = (i+1) & mask;
+    }
+    pH->ht[i].h = pNew->h;
+    pH->ht[i].elem = pNew;
   }
 }
 
-
-/* Resize the hash table so that it cantains "new_size" buckets.
+/* Resize the hash table so that it contains "new_size" slots. The
+** new size must be a power of two greater than the number of elements.
+**
+** Unlike most allocations made by SQLite, the size of the table is not
+** limited to SQLITE_MALLOC_SOFT_LIMIT bytes. An open addressing table
+** needs more slots than elements, so such a limit would force large
+** hashes, like the schema of a database with thousands of tables, back
+** to a linear search.
 **
-** The hash table might fail to resize if sqlite3_malloc() fails or
-** if the new size is the same as the prior size.
+** The hash table might fail to resize if sqlite3_malloc() fails.
 ** Return TRUE if the resize occurs and false if not.
 */
 static int rehash(Hash *pH, unsigned int new_size){
   struct _ht *new_ht;            /* The new hash table */
-  HashElem *elem, *next_elem;    /* For looping over existing elements */
+  HashElem *elem;                /* For looping over existing elements */
+  unsigned int mask = new_size - 1;
 
-#if SQLITE_MALLOC_SOFT_LIMIT>0
-  if( new_size*sizeof(struct _ht)>SQLITE_MALLOC_SOFT_LIMIT ){
-    new_size = SQLITE_MALLOC_SOFT_LIMIT/sizeof(struct _ht);
-  }
-  if( new_size==pH->htsize ) return 0;
-#endif
+  assert( new_size>pH->count && (new_size & mask)==0 );
 
   /* The inability to allocates space for a larger hash table is
   ** a performance hit but it is not a fatal error.  So mark the
-  ** allocation as a benign. Use sqlite3Malloc()/memset(0) instead of 
-  ** sqlite3MallocZero() to make the allocation, as sqlite3MallocZero()
-  ** only zeroes the requested number of bytes whereas this module will
-  ** use the actual amount of space allocated for the hash table (which
-  ** may be larger than the requested amount).
+  ** allocation as a benign.
   */
   sqlite3BeginBenignMalloc();
-  new_ht = (struct _ht *)sqlite3Malloc( new_size*sizeof(struct _ht) );
+  new_ht = (struct _ht *)sqlite3MallocZero( new_size*sizeof(struct _ht) );
   sqlite3EndBenignMalloc();
 
   if( new_ht==0 ) return 0;
   sqlite3_free(pH->ht);
   pH->ht = new_ht;
-  pH->htsize = new_size = sqlite3MallocSize(new_ht)/sizeof(struct _ht);
-  memset(new_ht, 0, new_size*sizeof(struct _ht));
-  for(elem=pH->first, pH->first=0; elem; elem = next_elem){
-    unsigned int h = strHash(elem->pKey, elem->nKey) % new_size;
-    next_elem = elem->next;
-    insertElement(pH, &new_ht[h], elem);
+  pH->htsize = new_size;
+  for(elem=pH->first; elem; elem=elem->next){
+    unsigned int i = elem->h & mask;
+    while( new_ht[i].elem ){
+      i = (i+1) & mask;
+    }
+    new_ht[i].h = elem->h;
+    new_ht[i].elem = elem;
   }
   return 1;
 }
@@ -139,6 +138,9 @@ static int rehash(Hash *pH, unsigned int new_size){
 /* This function (for internal use only) locates an element in an
 ** hash table that matches the given key.  The hash for this key has
 ** already been computed and is passed as the 4th parameter.
+**
+** The cached hash of each element is compared before its key, so that
+** the keys of other elements are seldom read.
 */
 static HashElem *findElementGivenHash(
   const Hash *pH,     /* The pH to be searched */
@@ -147,34 +149,63 @@ static HashElem *findElementGivenHash(
   unsigned int h      /* The hash for this key. */
 ){
   HashElem *elem;                /* Used to loop thru the element list */
-  int count;                     /* Number of elements left to test */
 
   if( pH->ht ){
-    struct _ht *pEntry = &pH->ht[h];
-    elem = pEntry->chain;
-    count = pEntry->count;
+    unsigned int mask = pH->htsize - 1;
+    unsigned int i;
+    for(i=h & mask; (elem = pH->ht[i].elem)!=0; i=(i+1) & mask){
+      if( pH->ht[i].h==h && elem->nKey==nKey
+       && sqlite3StrNICmp(elem->pKey,pKey,nKey)==0
+      ){
+        return elem;
+      }
+    }
   }else{
-    elem = pH->first;
-    count = pH->count;
-  }
-  while( count-- && ALWAYS(elem) ){
-    if( elem->nKey==nKey && sqlite3StrNICmp(elem->pKey,pKey,nKey)==0 ){ 
-      return elem;
+    for(elem=pH->first; elem; elem=elem->next){
+      if( elem->h==h && elem->nKey==nKey
+       && sqlite3StrNICmp(elem->pKey,pKey,nKey)==0
+      ){
+        return elem;
+      }
     }
-    elem = elem->next;
   }
   return 0;
 }
 
-/* Remove a single entry from the hash table given a pointer to that
-** element and a hash on the element's key.
+/* Remove element elem from the hash table of pH. Elements stored after
+** it in the same run of used slots are moved back, if required, so that
+** none of them is separated from the slot selected by its hash by a
+** free slot.
 */
-static void removeElementGivenHash(
+static void removeFromTable(Hash *pH, HashElem *elem){
+  struct _ht *ht = pH->ht;
+  unsigned int mask = pH->htsize - 1;
+  unsigned int i;                /* Slot being freed */
+  unsigned int j;                /* Slot that may be moved to slot i */
+  unsigned int k;                /* Slot selected by the hash of slot j */
+
+  for(i=elem->h & mask; ht[i].elem!=elem; i=(i+1) & mask){
+    assert( ht[i].elem!=0 );
+  }
+  j = i;
+  while( 1 ){
+    ht[i].elem = 0;
+    do{
+      j = (j+1) & mask;
+      if( ht[j].elem==0 ) return;
+      k = ht[j].h & mask;
+    }while( i<=j ? (i<k && k<=j) : (i<k || k<=j) );
+    ht[i] = ht[j];
+    i = j;
+  }
+}
+
+/* Remove a single entry from the hash table.
+*/
+static void removeElement(
   Hash *pH,         /* The pH containing "elem" */
-  HashElem* elem,   /* The element to be removed from the pH */
-  unsigned int h    /* Hash value for the element */
+  HashElem* elem    /* The element to be removed from the pH */
 ){
-  struct _ht *pEntry;
   if( elem->prev ){
     elem->prev->next = elem->next; 
   }else{
@@ -184,12 +215,7 @@ static void removeElementGivenHash(
     elem->next->prev = elem->prev;
   }
   if( pH->ht ){
-    pEntry = &pH->ht[h];
-    if( pEntry->chain==elem ){
-      pEntry->chain = elem->next;
-    }
-    pEntry->count--;
-    assert( pEntry->count>=0 );
+    removeFromTable(pH, elem);
   }
   sqlite3_free( elem );
   pH->count--;
@@ -206,17 +232,11 @@ static void removeElementGivenHash(
 */
 void *sqlite3HashFind(const Hash *pH, const char *pKey, int nKey){
   HashElem *elem;    /* The element that matches key */
-  unsigned int h;    /* A hash on key */
 
   assert( pH!=0 );
   assert( pKey!=0 );
   assert( nKey>=0 );
-  if( pH->ht ){
-    h = strHash(pKey, nKey) % pH->htsize;
-  }else{
-    h = 0;
-  }
-  elem = findElementGivenHash(pH, pKey, nKey, h);
+  elem = findElementGivenHash(pH, pKey, nKey, strHash(pKey, nKey));
   return elem ? elem->data : 0;
 }
 
@@ -235,23 +255,19 @@ void *sqlite3HashFind(const Hash *pH, const char *pKey, int nKey){
 ** element corresponding to "key" is removed from the hash table.
 */
 void *sqlite3HashInsert(Hash *pH, const char *pKey, int nKey, void *data){
-  unsigned int h;       /* the hash of the key modulo hash table size */
+  unsigned int h;       /* the hash of the key */
   HashElem *elem;       /* Used to loop thru the element list */
   HashElem *new_elem;   /* New element added to the pH */
 
   assert( pH!=0 );
   assert( pKey!=0 );
   assert( nKey>=0 );
-  if( pH->htsize ){
-    h = strHash(pKey, nKey) % pH->htsize;
-  }else{
-    h = 0;
-  }
+  h = strHash(pKey, nKey);
   elem = findElementGivenHash(pH,pKey,nKey,h);
   if( elem ){
     void *old_data = elem->data;
     if( data==0 ){
-      removeElementGivenHash(pH,elem,h);
+      removeElement(pH,elem);
     }else{
       elem->data = data;
       elem->pKey = pKey;
@@ -264,18 +280,22 @@ void *sqlite3HashInsert(Hash *pH, const char *pKey, int nKey, void *data){
   if( new_elem==0 ) return data;
   new_elem->pKey = pKey;
   new_elem->nKey = nKey;
+  new_elem->h = h;
   new_elem->data = data;
   pH->count++;
-  if( pH->count>=10 && pH->count > 2*pH->htsize ){
-    if( rehash(pH, pH->count*2) ){
-      assert( pH->htsize>0 );
-      h = strHash(pKey, nKey) % pH->htsize;
+
+  /* Keep no more than half of the slots in use. If the table cannot be
+  ** grown, it may be used until three quarters of its slots are in use,
+  ** after which lookups fall back to a linear search. */
+  if( pH->count>=HASH_MIN_COUNT && pH->count*2>pH->htsize ){
+    unsigned int new_size = pH->htsize ? pH->htsize*2 : HASH_MIN_SIZE;
+    while( new_size<pH->count*2 ) new_size *= 2;
+    if( !rehash(pH, new_size) && pH->count*4>pH->htsize*3 ){
+      sqlite3_free(pH->ht);
+      pH->ht = 0;
+      pH->htsize = 0;
     }
   }
-  if( pH->ht ){
-    insertElement(pH, &pH->ht[h], new_elem);
-  }else{
-    insertElement(pH, 0, new_elem);
-  }
+  insertElement(pH, new_elem);
   return 0;
 }
@@ -28,11 +28,16 @@ typedef struct HashElem HashElem;
 ** this structure opaque.
 **
 ** All elements of the hash table are on a single doubly-linked list.
-** Hash.first points to the head of this list.
+** Hash.first points to the head of this list. New elements are added at
+** the head, so the list is in reverse order of insertion. Resizing the
+** table does not change the list.
 **
-** There are Hash.htsize buckets.  Each bucket points to a spot in
-** the global doubly-linked list.  The contents of the bucket are the
-** element pointed to plus the next _ht.count-1 elements in the list.
+** Hash.ht is an open addressing table of Hash.htsize slots, where
+** Hash.htsize is a power of two. Each element is in the slot given by
+** the hash of its key or, if that slot was in use, in the first free slot
+** after it. A slot holds a copy of the hash of its element's key, so that
+** slots for other keys can be skipped without reading the element. No
+** more than half of the slots are in use after the table is resized.
 **
 ** Hash.htsize and Hash.ht may be zero.  In that case lookup is done
 ** by a linear search of the global list.  For small tables, the 
@@ -41,12 +46,12 @@ typedef struct HashElem HashElem;
 ** the hash table.
 */
 struct Hash {
-  unsigned int htsize;      /* Number of buckets in the hash table */
+  unsigned int htsize;      /* Number of slots in the hash table */
   unsigned int count;       /* Number of entries in this table */
   HashElem *first;          /* The first element of the array */
   struct _ht {              /* the hash table */
-    int count;                 /* Number of entries with this hash */
-    HashElem *chain;           /* Pointer to first entry with this hash */
+    unsigned int h;            /* Hash of the key of elem */
+    HashElem *elem;            /* Element in this slot, or NULL if free */
   } *ht;
 };
 
@@ -60,6 +65,7 @@ struct HashElem {
   HashElem *next, *prev;       /* Next and previous elements in the table */
   void *data;                  /* Data associated with this element */
   const char *pKey; int nKey;  /* Key associated with this element */
+  unsigned int h;              /* Hash of the key */
 };
 
 /*
@@ -411,6 +411,53 @@ int sqlite3CodeCoroutine(Parse *pParse, Select *pSelect, SelectDest *pDest){
 
 
 
+/*
+** Return true if the index entries for the rows written by an INSERT
+** statement that takes its data from a SELECT may be accumulated in
+** sorters and written to the non-UNIQUE indices of pTab in key order
+** after the last row has been inserted. Entries for UNIQUE indices are
+** always inserted as each row is written, since they are needed to
+** check the constraint on subsequent rows.
+**
+** Deferring index entries is only safe if nothing can read or delete
+** the index entry of a row inserted earlier by the same statement
+** before the statement finishes (so no triggers, no foreign key actions
+** and no REPLACE conflict resolution), and if the statement can never
+** stop part way through and leave the rows inserted so far in place
+** (so no FAIL conflict resolution). The caller makes sure that any other
+** error rolls back the whole statement.
+*/
+static int insertCanSortIndices(
+  Parse *pParse,        /* Parser context */
+  Table *pTab,          /* The table being inserted into */
+  Trigger *pTrigger,    /* List of triggers on pTab, if any */
+  int onError           /* How to handle constraint errors */
+){
+  Index *pIdx;
+  int nSort = 0;
+  int i;
+
+  if( (pParse->db->flags & SQLITE_SortIdxInsert)==0 ) return 0;
+  if( pTrigger || pParse->nested || pParse->pTriggerTab ) return 0;
+  if( sqlite3FkRequired(pParse, pTab, 0, 0) ) return 0;
+  if( onError==OE_Replace || onError==OE_Fail ) return 0;
+  if( onError==OE_Default ){
+    if( pTab->keyConf==OE_Replace || pTab->keyConf==OE_Fail ) return 0;
+    for(i=0; i<pTab->nCol; i++){
+      if( pTab->aCol[i].notNull==OE_Fail ) return 0;
+    }
+  }
+  for(pIdx=pTab->pIndex; pIdx; pIdx=pIdx->pNext){
+    if( pIdx->onError==OE_None ){
+      nSort++;
+    }else if( onError==OE_Default
+           && (pIdx->onError==OE_Replace || pIdx->onError==OE_Fail) ){
+      return 0;
+    }
+  }
+  return nSort>0;
+}
+
 /* Forward declaration */
 static int xferOptimization(
   Parse *pParse,        /* Parser context */
@@ -521,6 +568,12 @@ static int xferOptimization(
 **           transfer values form intermediate table into <table>
 **         end loop
 **      D: cleanup
+**
+** If the "PRAGMA sorted_index_insert" flag is set, the 3rd and 4th templates
+** may write the entries for non-UNIQUE indices into one sorter per index
+** instead of inserting them into the indices row by row. Once all rows
+** have been inserted, the contents of each sorter are written into its
+** index in key order. See insertCanSortIndices() for when this applies.
 */
 void sqlite3Insert(
   Parse *pParse,        /* Parser context */
@@ -561,6 +614,8 @@ void sqlite3Insert(
   int regData;          /* register holding first column to insert */
   int regEof = 0;       /* Register recording end of SELECT data */
   int *aRegIdx = 0;     /* One register allocated to each index */
+  int iSorter = 0;      /* Sorter cursor for first index, if sorting keys */
+  int nIdx = 0;         /* Number of indices on pTab */
 
 #ifndef SQLITE_OMIT_TRIGGER
   int isView;                 /* True if attempting to insert into a view */
@@ -803,19 +858,38 @@ void sqlite3Insert(
     sqlite3VdbeAddOp2(v, OP_Integer, 0, regRowCount);
   }
 
-  /* If this is not a view, open the table and and all indices */
+  /* If this is not a view, open the table and and all indices. The
+  ** second half of aRegIdx[] is used if index keys are sorted. */
   if( !isView ){
-    int nIdx;
-
     baseCur = pParse->nTab;
     nIdx = sqlite3OpenTableAndIndices(pParse, pTab, baseCur, OP_OpenWrite);
-    aRegIdx = sqlite3DbMallocRaw(db, sizeof(int)*(nIdx+1));
+    aRegIdx = sqlite3DbMallocRaw(db, sizeof(int)*(nIdx+1)*2);
     if( aRegIdx==0 ){
       goto insert_cleanup;
     }
     for(i=0; i<nIdx; i++){
       aRegIdx[i] = ++pParse->nMem;
     }
+
+    /* If the index entries for non-UNIQUE indices are to be sorted, open
+    ** a sorter for each such index. The sorter for the i-th index uses
+    ** cursor number iSorter+i. A statement journal is required, as an
+    ** error part way through must not leave rows in the table that have
+    ** no entries in the sorted indices.  */
+    if( pSelect && !IsVirtual(pTab)
+     && insertCanSortIndices(pParse, pTab, pTrigger, onError)
+    ){
+      iSorter = pParse->nTab;
+      pParse->nTab += nIdx;
+      pParse->needStmtJournal = 1;
+      for(i=0, pIdx=pTab->pIndex; pIdx; pIdx=pIdx->pNext, i++){
+        if( pIdx->onError==OE_None ){
+          KeyInfo *pKey = sqlite3IndexKeyinfo(pParse, pIdx);
+          sqlite3VdbeAddOp4(v, OP_SorterOpen, iSorter+i, 0, 0,
+                            (char*)pKey, P4_KEYINFO_HANDOFF);
+        }
+      }
+    }
   }
 
   /* This is the top of the main insertion loop */
@@ -1032,9 +1106,27 @@ void sqlite3Insert(
           keyColumn>=0, 0, onError, endOfLoop, &isReplace
       );
       sqlite3FkCheck(pParse, pTab, 0, regIns);
-      sqlite3CompleteInsertion(
-          pParse, pTab, baseCur, regIns, aRegIdx, 0, appendFlag, isReplace==0
-      );
+      if( iSorter ){
+        /* Write the keys for non-UNIQUE indices into their sorters. Only
+        ** the UNIQUE indices are passed to sqlite3CompleteInsertion(). */
+        int *aRegIns = &aRegIdx[nIdx];
+        assert( isReplace==0 );
+        for(i=0, pIdx=pTab->pIndex; pIdx; pIdx=pIdx->pNext, i++){
+          if( pIdx->onError==OE_None ){
+            sqlite3VdbeAddOp2(v, OP_SorterInsert, iSorter+i, aRegIdx[i]);
+            aRegIns[i] = 0;
+          }else{
+            aRegIns[i] = aRegIdx[i];
+          }
+        }
+        sqlite3CompleteInsertion(
+            pParse, pTab, baseCur, regIns, aRegIns, 0, appendFlag, isReplace==0
+        );
+      }else{
+        sqlite3CompleteInsertion(
+            pParse, pTab, baseCur, regIns, aRegIdx, 0, appendFlag, isReplace==0
+        );
+      }
     }
   }
 
@@ -1063,6 +1155,22 @@ void sqlite3Insert(
     sqlite3VdbeJumpHere(v, addrInsTop);
   }
 
+  if( iSorter ){
+    /* Copy the sorted keys from each sorter into its index */
+    int regRec = sqlite3GetTempReg(pParse);
+    for(idx=0, pIdx=pTab->pIndex; pIdx; pIdx=pIdx->pNext, idx++){
+      int addr1, addr2;
+      if( pIdx->onError!=OE_None ) continue;
+      addr1 = sqlite3VdbeAddOp2(v, OP_SorterSort, iSorter+idx, 0);
+      addr2 = sqlite3VdbeAddOp2(v, OP_SorterData, iSorter+idx, regRec);
+      sqlite3VdbeAddOp2(v, OP_IdxInsert, baseCur+idx+1, regRec);
+      sqlite3VdbeAddOp2(v, OP_SorterNext, iSorter+idx, addr2);
+      sqlite3VdbeJumpHere(v, addr1);
+      sqlite3VdbeAddOp1(v, OP_Close, iSorter+idx);
+    }
+    sqlite3ReleaseTempReg(pParse, regRec);
+  }
+
   if( !IsVirtual(pTab) && !isView ){
     /* Close all tables opened */
     sqlite3VdbeAddOp1(v, OP_Close, baseCur);
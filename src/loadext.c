@@ -709,7 +709,7 @@ void sqlite3AutoLoadExtensions(sqlite3 *db){
 #if SQLITE_THREADSAFE
     sqlite3_mutex *mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MASTER);
 #endif
-    sqlite3_mutex_enter(mutex);
+    sqlite3MutexEnterShared(mutex);
     if( i>=wsdAutoext.nExt ){
       xInit = 0;
       go = 0;
@@ -717,7 +717,7 @@ void sqlite3AutoLoadExtensions(sqlite3 *db){
       xInit = (int(*)(sqlite3*,char**,const sqlite3_api_routines*))
               wsdAutoext.aExt[i];
     }
-    sqlite3_mutex_leave(mutex);
+    sqlite3MutexLeaveShared(mutex);
     zErrmsg = 0;
     if( xInit && (rc = xInit(db, &zErrmsg, &sqlite3Apis))!=0 ){
       sqlite3Error(db, rc,
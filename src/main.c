@@ -368,6 +368,7 @@ int sqlite3_config(int op, ...){
     case SQLITE_CONFIG_MALLOC: {
       /* Specify an alternative malloc implementation */
       sqlite3GlobalConfig.m = *va_arg(ap, sqlite3_mem_methods*);
+      sqlite3GlobalConfig.bMemThreadsafe = 0;
       break;
     }
     case SQLITE_CONFIG_GETMALLOC: {
@@ -443,13 +444,17 @@ int sqlite3_config(int op, ...){
       }else{
         /* The heap pointer is not NULL, then install one of the
         ** mem5.c/mem3.c methods. If neither ENABLE_MEMSYS3 nor
-        ** ENABLE_MEMSYS5 is defined, return an error.
+        ** ENABLE_MEMSYS5 is defined, return an error. memsys3 relies on
+        ** malloc.c to serialize calls to it. memsys5 serializes them itself
+        ** (see memsys5Init()).
         */
+        sqlite3GlobalConfig.bMemThreadsafe = 0;
 #ifdef SQLITE_ENABLE_MEMSYS3
         sqlite3GlobalConfig.m = *sqlite3MemGetMemsys3();
 #endif
 #ifdef SQLITE_ENABLE_MEMSYS5
         sqlite3GlobalConfig.m = *sqlite3MemGetMemsys5();
+        sqlite3GlobalConfig.bMemThreadsafe = 1;
 #endif
       }
       break;
@@ -528,10 +533,14 @@ int sqlite3_config(int op, ...){
 ** space for the lookaside memory is obtained from sqlite3_malloc().
 ** If pStart is not NULL then it is sz*cnt bytes of memory to use for
 ** the lookaside memory.
+**
+** The size classes larger than sz are used for requests that do not fit
+** in, or cannot be satisfied from, the sz byte slots.
 */
 static int setupLookaside(sqlite3 *db, void *pBuf, int sz, int cnt){
   void *pStart;
-  if( db->lookaside.nOut ){
+  int i;
+  if( db->lookaside.nOut || db->lookaside.nChunkOut ){
     return SQLITE_BUSY;
   }
   /* Free any existing lookaside buffer for this handle before
@@ -541,6 +550,7 @@ static int setupLookaside(sqlite3 *db, void *pBuf, int sz, int cnt){
   if( db->lookaside.bMalloced ){
     sqlite3_free(db->lookaside.pStart);
   }
+  sqlite3LookasideFreeChunks(db);
   /* The size of a lookaside slot after ROUNDDOWN8 needs to be larger
   ** than a pointer to be useful.
   */
@@ -561,8 +571,11 @@ static int setupLookaside(sqlite3 *db, void *pBuf, int sz, int cnt){
   db->lookaside.pStart = pStart;
   db->lookaside.pFree = 0;
   db->lookaside.sz = (u16)sz;
+  for(i=0; i<LOOKASIDE_NCLASS; i++){
+    int szClass = LOOKASIDE_CLASS_MIN<<i;
+    db->lookaside.aClass[i].sz = (u16)(szClass>sz ? szClass : 0);
+  }
   if( pStart ){
-    int i;
     LookasideSlot *p;
     assert( sz > (int)sizeof(LookasideSlot*) );
     p = (LookasideSlot*)pStart;
@@ -604,6 +617,9 @@ int sqlite3_db_release_memory(sqlite3 *db){
       sqlite3PagerShrink(pPager);
     }
   }
+  if( db->lookaside.nChunkOut==0 ){
+    sqlite3LookasideFreeChunks(db);
+  }
   sqlite3BtreeLeaveAll(db);
   sqlite3_mutex_leave(db->mutex);
   return SQLITE_OK;
@@ -991,6 +1007,9 @@ void sqlite3LeaveMutexAndCloseZombie(sqlite3 *db){
   db->magic = SQLITE_MAGIC_CLOSED;
   sqlite3_mutex_free(db->mutex);
   assert( db->lookaside.nOut==0 );  /* Fails on a lookaside memory leak */
+  assert( db->lookaside.nChunkOut==0 );
+  sqlite3LookasideFreeChunks(db);
+  sqlite3ArenaClose(db);
   if( db->lookaside.bMalloced ){
     sqlite3_free(db->lookaside.pStart);
   }
@@ -1064,6 +1083,7 @@ const char *sqlite3ErrName(int rc){
       case SQLITE_ABORT_ROLLBACK:     zName = "SQLITE_ABORT_ROLLBACK";    break;
       case SQLITE_BUSY:               zName = "SQLITE_BUSY";              break;
       case SQLITE_BUSY_RECOVERY:      zName = "SQLITE_BUSY_RECOVERY";     break;
+      case SQLITE_BUSY_SNAPSHOT:      zName = "SQLITE_BUSY_SNAPSHOT";     break;
       case SQLITE_LOCKED:             zName = "SQLITE_LOCKED";            break;
       case SQLITE_LOCKED_SHAREDCACHE: zName = "SQLITE_LOCKED_SHAREDCACHE";break;
       case SQLITE_NOMEM:              zName = "SQLITE_NOMEM";             break;
@@ -1228,6 +1248,26 @@ static int sqliteDefaultBusyCallback(
     delay = delays[NDELAY-1];
     prior = totals[NDELAY-1] + delay*(count-(NDELAY-1));
   }
+  if( count==0 ) db->busyHandler.iStart = 0;
+  if( db->busyHandler.pFile && db->busyHandler.pFile->pMethods ){
+    /* Give the VFS a chance to wait for the lock to be released instead
+    ** of sleeping. Such a wait may end long before the delay has passed,
+    ** so the timeout is measured using the real time elapsed since the
+    ** first such wait, plus the time spent sleeping before it. */
+    sqlite3_int64 iNow;
+    if( sqlite3OsCurrentTimeInt64(db->pVfs, &iNow)==SQLITE_OK ){
+      int us;
+      if( db->busyHandler.iStart==0 ) db->busyHandler.iStart = iNow - prior;
+      prior = (int)(iNow - db->busyHandler.iStart);
+      if( prior>=timeout ) return 0;
+      us = (prior + delay > timeout ? timeout - prior : delay) * 1000;
+      if( sqlite3OsFileControl(db->busyHandler.pFile, 
+                               SQLITE_FCNTL_BUSY_WAIT, (void*)&us)==SQLITE_OK
+      ){
+        return 1;
+      }
+    }
+  }
   if( prior + delay > timeout ){
     delay = timeout - prior;
     if( delay<=0 ) return 0;
@@ -2463,6 +2503,9 @@ static int openDatabase(
 #endif
 #if defined(SQLITE_DEFAULT_FOREIGN_KEYS) && SQLITE_DEFAULT_FOREIGN_KEYS
                  | SQLITE_ForeignKeys
+#endif
+#if defined(SQLITE_DEFAULT_LAZY_SCHEMA) && SQLITE_DEFAULT_LAZY_SCHEMA
+                 | SQLITE_LazySchema
 #endif
       ;
   sqlite3HashInit(&db->aCollSeq);
@@ -2588,6 +2631,7 @@ static int openDatabase(
 #endif
 
   /* Enable the lookaside-malloc subsystem */
+  sqlite3LookasideGrowth(db, SQLITE_DEFAULT_LOOKASIDE_GROWTH);
   setupLookaside(db, 0, sqlite3GlobalConfig.szLookaside,
                         sqlite3GlobalConfig.nLookaside);
 
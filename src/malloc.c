@@ -71,10 +71,44 @@ static SQLITE_WSD struct Mem0Global {
   ** sqlite3_soft_heap_limit() setting.
   */
   int nearlyFull;
+
+#ifdef SQLITE_ENABLE_HUGEPAGE
+  /*
+  ** The page-cache arena and its size in bytes, if it was allocated by
+  ** SQLite because SQLITE_CONFIG_PAGECACHE was given a NULL pointer.
+  */
+  void *pPageArena;
+  sqlite3_int64 nPageArena;
+#endif
 } mem0 = { 0, 0, 0, 0, 0, 0, 0, 0 };
 
 #define mem0 GLOBAL(struct Mem0Global, mem0)
 
+/*
+** The memory statistics are maintained while holding mem0.mutex, which
+** also serializes calls to the xMalloc, xRealloc and xFree methods, as
+** documented for SQLITE_CONFIG_MEMSTATUS. If the status counters are
+** updated using atomic operations and the allocator is threadsafe, the
+** mutex is only used to invoke the alarm callback (for example when the
+** soft heap limit is exceeded). memNoMutex() is true in that case, and
+** memEnter() and memLeave() do nothing.
+**
+** The soft heap limit is then only approximate, as the amount of memory
+** in use may change between the time it is checked and the time the
+** allocation is made.
+*/
+#ifdef SQLITE_STATUS_ATOMIC
+# define memNoMutex() (sqlite3GlobalConfig.bMemThreadsafe)
+#else
+# define memNoMutex() 0
+#endif
+static void memEnter(void){
+  if( !memNoMutex() ) sqlite3_mutex_enter(mem0.mutex);
+}
+static void memLeave(void){
+  if( !memNoMutex() ) sqlite3_mutex_leave(mem0.mutex);
+}
+
 /*
 ** This routine runs when the memory allocator sees that the
 ** total memory allocation is about to exceed the soft heap
@@ -184,6 +218,20 @@ int sqlite3MallocInit(void){
     sqlite3GlobalConfig.szScratch = 0;
     sqlite3GlobalConfig.nScratch = 0;
   }
+#ifdef SQLITE_ENABLE_HUGEPAGE
+  /* If no page-cache buffer was supplied but its size was, allocate it
+  ** from the OS, backed by huge pages if possible. */
+  if( sqlite3GlobalConfig.pPage==0 && sqlite3GlobalConfig.szPage>=512
+      && sqlite3GlobalConfig.nPage>=1 ){
+    sqlite3_int64 nByte = ROUNDDOWN8(sqlite3GlobalConfig.szPage);
+    nByte *= sqlite3GlobalConfig.nPage;
+    mem0.pPageArena = sqlite3OsHugeAlloc(nByte);
+    if( mem0.pPageArena ){
+      mem0.nPageArena = nByte;
+      sqlite3GlobalConfig.pPage = mem0.pPageArena;
+    }
+  }
+#endif
   if( sqlite3GlobalConfig.pPage==0 || sqlite3GlobalConfig.szPage<512
       || sqlite3GlobalConfig.nPage<1 ){
     sqlite3GlobalConfig.pPage = 0;
@@ -209,6 +257,13 @@ void sqlite3MallocEnd(void){
   if( sqlite3GlobalConfig.m.xShutdown ){
     sqlite3GlobalConfig.m.xShutdown(sqlite3GlobalConfig.m.pAppData);
   }
+#ifdef SQLITE_ENABLE_HUGEPAGE
+  if( mem0.pPageArena ){
+    assert( sqlite3GlobalConfig.pPage==mem0.pPageArena );
+    sqlite3OsHugeFree(mem0.pPageArena, mem0.nPageArena);
+    sqlite3GlobalConfig.pPage = 0;
+  }
+#endif
   memset(&mem0, 0, sizeof(mem0));
 }
 
@@ -237,13 +292,21 @@ sqlite3_int64 sqlite3_memory_highwater(int resetFlag){
 }
 
 /*
-** Trigger the alarm 
+** Trigger the alarm.  The caller holds mem0.mutex unless memNoMutex()
+** is true.
 */
 static void sqlite3MallocAlarm(int nByte){
   void (*xCallback)(void*,sqlite3_int64,int);
   sqlite3_int64 nowUsed;
   void *pArg;
   if( mem0.alarmCallback==0 ) return;
+  if( memNoMutex() ){
+    sqlite3_mutex_enter(mem0.mutex);
+    if( mem0.alarmCallback==0 ){
+      sqlite3_mutex_leave(mem0.mutex);
+      return;
+    }
+  }
   xCallback = mem0.alarmCallback;
   nowUsed = sqlite3StatusValue(SQLITE_STATUS_MEMORY_USED);
   pArg = mem0.alarmArg;
@@ -253,16 +316,17 @@ static void sqlite3MallocAlarm(int nByte){
   sqlite3_mutex_enter(mem0.mutex);
   mem0.alarmCallback = xCallback;
   mem0.alarmArg = pArg;
+  if( memNoMutex() ) sqlite3_mutex_leave(mem0.mutex);
 }
 
 /*
 ** Do a memory allocation with statistics and alarms.  Assume the
-** lock is already held.
+** lock is already held, unless memNoMutex() is true.
 */
 static int mallocWithAlarm(int n, void **pp){
   int nFull;
   void *p;
-  assert( sqlite3_mutex_held(mem0.mutex) );
+  assert( memNoMutex() || sqlite3_mutex_held(mem0.mutex) );
   nFull = sqlite3GlobalConfig.m.xRoundup(n);
   sqlite3StatusSet(SQLITE_STATUS_MALLOC_SIZE, n);
   if( mem0.alarmCallback!=0 ){
@@ -306,9 +370,9 @@ void *sqlite3Malloc(int n){
     ** this amount.  The only way to reach the limit is with sqlite3_malloc() */
     p = 0;
   }else if( sqlite3GlobalConfig.bMemstat ){
-    sqlite3_mutex_enter(mem0.mutex);
+    memEnter();
     mallocWithAlarm(n, &p);
-    sqlite3_mutex_leave(mem0.mutex);
+    memLeave();
   }else{
     p = sqlite3GlobalConfig.m.xMalloc(n);
   }
@@ -361,10 +425,11 @@ void *sqlite3ScratchMalloc(int n){
     sqlite3_mutex_leave(mem0.mutex);
   }else{
     if( sqlite3GlobalConfig.bMemstat ){
+      if( memNoMutex() ) sqlite3_mutex_leave(mem0.mutex);
       sqlite3StatusSet(SQLITE_STATUS_SCRATCH_SIZE, n);
       n = mallocWithAlarm(n, &p);
       if( p ) sqlite3StatusAdd(SQLITE_STATUS_SCRATCH_OVERFLOW, n);
-      sqlite3_mutex_leave(mem0.mutex);
+      memLeave();
     }else{
       sqlite3_mutex_leave(mem0.mutex);
       p = sqlite3GlobalConfig.m.xMalloc(n);
@@ -415,12 +480,12 @@ void sqlite3ScratchFree(void *p){
       sqlite3MemdebugSetType(p, MEMTYPE_HEAP);
       if( sqlite3GlobalConfig.bMemstat ){
         int iSize = sqlite3MallocSize(p);
-        sqlite3_mutex_enter(mem0.mutex);
+        memEnter();
         sqlite3StatusAdd(SQLITE_STATUS_SCRATCH_OVERFLOW, -iSize);
         sqlite3StatusAdd(SQLITE_STATUS_MEMORY_USED, -iSize);
         sqlite3StatusAdd(SQLITE_STATUS_MALLOC_COUNT, -1);
         sqlite3GlobalConfig.m.xFree(p);
-        sqlite3_mutex_leave(mem0.mutex);
+        memLeave();
       }else{
         sqlite3GlobalConfig.m.xFree(p);
       }
@@ -435,8 +500,69 @@ void sqlite3ScratchFree(void *p){
 static int isLookaside(sqlite3 *db, void *p){
   return p && p>=db->lookaside.pStart && p<db->lookaside.pEnd;
 }
+
+/*
+** If p is a slot of one of the lookaside size classes of db, return
+** the LookasideClass object it belongs to. Otherwise return NULL.
+*/
+static LookasideClass *lookasideClass(sqlite3 *db, void *p){
+  Lookaside *pLook = &db->lookaside;
+  if( p>=pLook->pChunkLo && p<pLook->pChunkHi ){
+    int i;
+    for(i=0; i<pLook->nChunk; i++){
+      u8 *pChunk = pLook->apChunk[i];
+      if( (u8*)p>=pChunk && (u8*)p<&pChunk[LOOKASIDE_CHUNK_SZ] ){
+        return &pLook->aClass[pLook->aChunkClass[i]];
+      }
+    }
+  }
+  return 0;
+}
 #else
 #define isLookaside(A,B) 0
+#define lookasideClass(A,B) ((LookasideClass*)0)
+#endif
+
+/*
+** Each chunk of memory in the parse arena (see the ParseArena object)
+** begins with an instance of the following structure. The nByte bytes
+** of space available for allocations follow it.
+*/
+struct ArenaChunk {
+  ArenaChunk *pNext;      /* Next older chunk */
+  int nByte;              /* Bytes of space in this chunk */
+  int iUsed;              /* Bytes of space already allocated */
+};
+
+/*
+** Sizes of the first and largest chunks of the parse arena, and of the
+** largest allocation made from the arena. Larger requests are passed
+** to sqlite3DbMallocRaw().
+*/
+#define ARENA_CHUNK_MIN   1024
+#define ARENA_CHUNK_MAX  65536
+#define ARENA_ALLOC_MAX   (ARENA_CHUNK_MAX/8)
+
+/*
+** Return a pointer to the first byte of the space in chunk p.
+*/
+#define arenaSpace(p) (&((u8*)(p))[ROUND8(sizeof(ArenaChunk))])
+
+/*
+** TRUE if p is a parse arena allocation from db
+*/
+#ifndef SQLITE_OMIT_LOOKASIDE
+static int isArena(sqlite3 *db, void *p){
+  ArenaChunk *pChunk;
+  if( db->arena.nDepth==0 ) return 0;
+  for(pChunk=db->arena.pChunk; pChunk; pChunk=pChunk->pNext){
+    u8 *aSpace = arenaSpace(pChunk);
+    if( (u8*)p>=aSpace && (u8*)p<&aSpace[pChunk->nByte] ) return 1;
+  }
+  return 0;
+}
+#else
+#define isArena(A,B) 0
 #endif
 
 /*
@@ -449,9 +575,13 @@ int sqlite3MallocSize(void *p){
   return sqlite3GlobalConfig.m.xSize(p);
 }
 int sqlite3DbMallocSize(sqlite3 *db, void *p){
+  LookasideClass *pClass;
   assert( db==0 || sqlite3_mutex_held(db->mutex) );
+  assert( db==0 || !isArena(db, p) );
   if( db && isLookaside(db, p) ){
     return db->lookaside.sz;
+  }else if( db && (pClass = lookasideClass(db, p))!=0 ){
+    return pClass->sz;
   }else{
     assert( sqlite3MemdebugHasType(p, MEMTYPE_DB) );
     assert( sqlite3MemdebugHasType(p, MEMTYPE_LOOKASIDE|MEMTYPE_HEAP) );
@@ -468,11 +598,11 @@ void sqlite3_free(void *p){
   assert( sqlite3MemdebugNoType(p, MEMTYPE_DB) );
   assert( sqlite3MemdebugHasType(p, MEMTYPE_HEAP) );
   if( sqlite3GlobalConfig.bMemstat ){
-    sqlite3_mutex_enter(mem0.mutex);
+    memEnter();
     sqlite3StatusAdd(SQLITE_STATUS_MEMORY_USED, -sqlite3MallocSize(p));
     sqlite3StatusAdd(SQLITE_STATUS_MALLOC_COUNT, -1);
     sqlite3GlobalConfig.m.xFree(p);
-    sqlite3_mutex_leave(mem0.mutex);
+    memLeave();
   }else{
     sqlite3GlobalConfig.m.xFree(p);
   }
@@ -483,8 +613,13 @@ void sqlite3_free(void *p){
 ** connection.
 */
 void sqlite3DbFree(sqlite3 *db, void *p){
+  LookasideClass *pClass;
   assert( db==0 || sqlite3_mutex_held(db->mutex) );
   if( db ){
+    if( isArena(db, p) ){
+      /* Released by sqlite3ArenaEnd() */
+      return;
+    }
     if( db->pnBytesFreed ){
       *db->pnBytesFreed += sqlite3DbMallocSize(db, p);
       return;
@@ -500,6 +635,16 @@ void sqlite3DbFree(sqlite3 *db, void *p){
       db->lookaside.nOut--;
       return;
     }
+    if( (pClass = lookasideClass(db, p))!=0 ){
+      LookasideSlot *pBuf = (LookasideSlot*)p;
+#if SQLITE_DEBUG
+      memset(p, 0xaa, pClass->sz);
+#endif
+      pBuf->pNext = pClass->pFree;
+      pClass->pFree = pBuf;
+      db->lookaside.nChunkOut--;
+      return;
+    }
   }
   assert( sqlite3MemdebugHasType(p, MEMTYPE_DB) );
   assert( sqlite3MemdebugHasType(p, MEMTYPE_LOOKASIDE|MEMTYPE_HEAP) );
@@ -533,7 +678,7 @@ void *sqlite3Realloc(void *pOld, int nBytes){
   if( nOld==nNew ){
     pNew = pOld;
   }else if( sqlite3GlobalConfig.bMemstat ){
-    sqlite3_mutex_enter(mem0.mutex);
+    memEnter();
     sqlite3StatusSet(SQLITE_STATUS_MALLOC_SIZE, nBytes);
     nDiff = nNew - nOld;
     if( sqlite3StatusValue(SQLITE_STATUS_MEMORY_USED) >= 
@@ -551,7 +696,7 @@ void *sqlite3Realloc(void *pOld, int nBytes){
       nNew = sqlite3MallocSize(pNew);
       sqlite3StatusAdd(SQLITE_STATUS_MEMORY_USED, nNew-nOld);
     }
-    sqlite3_mutex_leave(mem0.mutex);
+    memLeave();
   }else{
     pNew = sqlite3GlobalConfig.m.xRealloc(pOld, nNew);
   }
@@ -594,6 +739,127 @@ void *sqlite3DbMallocZero(sqlite3 *db, int n){
   return p;
 }
 
+#ifndef SQLITE_OMIT_LOOKASIDE
+/*
+** Add a chunk of LOOKASIDE_CHUNK_SZ bytes to the free list of lookaside
+** size class pClass. Return non-zero if successful, or zero if the
+** connection already has its maximum number of chunks or the allocation
+** fails. In the latter case the mallocFailed flag is also set, so that
+** an out-of-memory condition is reported the same way whether or not
+** the request would have been served by lookaside.
+*/
+static int lookasideGrow(sqlite3 *db, LookasideClass *pClass){
+  Lookaside *pLook = &db->lookaside;
+  u8 *pChunk;                     /* New chunk */
+  u8 *pEnd;                       /* First byte past the end of pChunk */
+  int i;
+
+  if( pLook->nChunk>=pLook->mxChunk ) return 0;
+  pChunk = (u8*)sqlite3Malloc(LOOKASIDE_CHUNK_SZ);
+  if( pChunk==0 ){
+    db->mallocFailed = 1;
+    return 0;
+  }
+  pEnd = &pChunk[LOOKASIDE_CHUNK_SZ];
+
+  assert( (LOOKASIDE_CHUNK_SZ % pClass->sz)==0 );
+  for(i=LOOKASIDE_CHUNK_SZ-pClass->sz; i>=0; i-=pClass->sz){
+    LookasideSlot *pBuf = (LookasideSlot*)&pChunk[i];
+    pBuf->pNext = pClass->pFree;
+    pClass->pFree = pBuf;
+  }
+  if( pLook->nChunk==0 || (void*)pChunk<pLook->pChunkLo ){
+    pLook->pChunkLo = (void*)pChunk;
+  }
+  if( pLook->nChunk==0 || (void*)pEnd>pLook->pChunkHi ){
+    pLook->pChunkHi = (void*)pEnd;
+  }
+  pLook->apChunk[pLook->nChunk] = pChunk;
+  pLook->aChunkClass[pLook->nChunk] = (u8)(pClass - pLook->aClass);
+  pLook->nChunk++;
+  return 1;
+}
+
+/*
+** Allocate n bytes from the lookaside size classes of db. This is called
+** when the request cannot be satisfied from the lookaside buffers.
+**
+** The slot is taken from the smallest class large enough, adding a chunk
+** to that class if it has no free slots. If the chunk limit has been
+** reached, a free slot of a larger class is used instead. NULL is
+** returned if there is no suitable class or no slot can be found, or
+** if a chunk cannot be allocated.
+*/
+static LookasideSlot *lookasideClassMalloc(sqlite3 *db, int n){
+  Lookaside *pLook = &db->lookaside;
+  LookasideClass *pClass = 0;
+  LookasideSlot *pBuf;
+  int i;
+
+  for(i=0; i<LOOKASIDE_NCLASS; i++){
+    if( pLook->aClass[i].sz>=n && pLook->aClass[i].sz>0 ){
+      pClass = &pLook->aClass[i];
+      break;
+    }
+  }
+  if( pClass==0 ){
+    pLook->anStat[n>pLook->sz ? 1 : 2]++;
+    return 0;
+  }
+  if( pClass->pFree==0 && lookasideGrow(db, pClass)==0 ){
+    int j;
+    if( db->mallocFailed ) return 0;
+    for(j=i+1; j<LOOKASIDE_NCLASS && pLook->aClass[j].pFree==0; j++){}
+    if( j==LOOKASIDE_NCLASS ){
+      pClass->anStat[1]++;
+      pLook->anStat[n>pLook->sz ? 1 : 2]++;
+      return 0;
+    }
+    pClass = &pLook->aClass[j];
+  }
+  pBuf = pClass->pFree;
+  pClass->pFree = pBuf->pNext;
+  pClass->anStat[0]++;
+  pLook->anStat[0]++;
+  pLook->nChunkOut++;
+  return pBuf;
+}
+#endif /* SQLITE_OMIT_LOOKASIDE */
+
+/*
+** Free all chunks belonging to the lookaside size classes of db. None of
+** their slots may be checked out.
+*/
+void sqlite3LookasideFreeChunks(sqlite3 *db){
+  Lookaside *pLook = &db->lookaside;
+  int i;
+  assert( pLook->nChunkOut==0 );
+  for(i=0; i<pLook->nChunk; i++){
+    sqlite3_free(pLook->apChunk[i]);
+  }
+  for(i=0; i<LOOKASIDE_NCLASS; i++){
+    pLook->aClass[i].pFree = 0;
+  }
+  pLook->nChunk = 0;
+  pLook->pChunkLo = 0;
+  pLook->pChunkHi = 0;
+}
+
+/*
+** Set the limit on the memory used by the chunks of the lookaside size
+** classes of db to nByte bytes, rounded down to a whole number of chunks.
+** If nByte is negative, leave the limit unchanged. Return the limit in
+** bytes.
+*/
+int sqlite3LookasideGrowth(sqlite3 *db, int nByte){
+  if( nByte>=0 ){
+    int nChunk = nByte/LOOKASIDE_CHUNK_SZ;
+    if( nChunk>LOOKASIDE_MAX_CHUNK ) nChunk = LOOKASIDE_MAX_CHUNK;
+    db->lookaside.mxChunk = nChunk;
+  }
+  return db->lookaside.mxChunk*LOOKASIDE_CHUNK_SZ;
+}
+
 /*
 ** Allocate and zero memory.  If the allocation fails, make
 ** the mallocFailed flag in the connection pointer.
@@ -623,11 +889,7 @@ void *sqlite3DbMallocRaw(sqlite3 *db, int n){
       return 0;
     }
     if( db->lookaside.bEnabled ){
-      if( n>db->lookaside.sz ){
-        db->lookaside.anStat[1]++;
-      }else if( (pBuf = db->lookaside.pFree)==0 ){
-        db->lookaside.anStat[2]++;
-      }else{
+      if( n<=db->lookaside.sz && (pBuf = db->lookaside.pFree)!=0 ){
         db->lookaside.pFree = pBuf->pNext;
         db->lookaside.nOut++;
         db->lookaside.anStat[0]++;
@@ -636,6 +898,9 @@ void *sqlite3DbMallocRaw(sqlite3 *db, int n){
         }
         return (void*)pBuf;
       }
+      if( (pBuf = lookasideClassMalloc(db, n))!=0 || db->mallocFailed ){
+        return (void*)pBuf;
+      }
     }
   }
 #else
@@ -664,13 +929,15 @@ void *sqlite3DbRealloc(sqlite3 *db, void *p, int n){
     if( p==0 ){
       return sqlite3DbMallocRaw(db, n);
     }
-    if( isLookaside(db, p) ){
-      if( n<=db->lookaside.sz ){
+    assert( !isArena(db, p) );
+    if( isLookaside(db, p) || lookasideClass(db, p) ){
+      int sz = sqlite3DbMallocSize(db, p);
+      if( n<=sz ){
         return p;
       }
       pNew = sqlite3DbMallocRaw(db, n);
       if( pNew ){
-        memcpy(pNew, p, db->lookaside.sz);
+        memcpy(pNew, p, sz);
         sqlite3DbFree(db, p);
       }
     }else{
@@ -702,6 +969,129 @@ void *sqlite3DbReallocOrFree(sqlite3 *db, void *p, int n){
   return pNew;
 }
 
+/*
+** Allocate memory for a parse tree object. The memory is taken from the
+** parse arena if sqlite3RunParser() is running and lookaside is enabled.
+** Otherwise, or if the request is too large, this routine is the same
+** as sqlite3DbMallocRaw(). Either way the memory is freed by passing it
+** to sqlite3DbFree(), and must never be resized.
+**
+** If the allocation fails, the mallocFailed flag is set.
+*/
+void *sqlite3ArenaMallocRaw(sqlite3 *db, int n){
+#ifndef SQLITE_OMIT_LOOKASIDE
+  if( db && db->arena.nDepth>0 && db->lookaside.bEnabled
+   && n<=ARENA_ALLOC_MAX
+  ){
+    ArenaChunk *pChunk = db->arena.pChunk;
+    void *p;
+    assert( sqlite3_mutex_held(db->mutex) );
+    if( db->mallocFailed ){
+      return 0;
+    }
+    n = ROUND8(n);
+    if( pChunk==0 || pChunk->iUsed+n>pChunk->nByte ){
+      /* Each chunk is twice the size of the one before it, up to a limit,
+      ** and at least large enough for the request. Whatever space is left
+      ** in the old chunk is not used. */
+      int nByte = ARENA_CHUNK_MIN;
+      if( pChunk ){
+        nByte = pChunk->nByte*2;
+        if( nByte>ARENA_CHUNK_MAX ) nByte = ARENA_CHUNK_MAX;
+      }
+      while( nByte<n ) nByte *= 2;
+      pChunk = (ArenaChunk*)sqlite3Malloc(ROUND8(sizeof(ArenaChunk))+nByte);
+      if( pChunk==0 ){
+        db->mallocFailed = 1;
+        return 0;
+      }
+      pChunk->pNext = db->arena.pChunk;
+      pChunk->nByte = nByte;
+      pChunk->iUsed = 0;
+      db->arena.pChunk = pChunk;
+    }
+    p = (void*)&arenaSpace(pChunk)[pChunk->iUsed];
+    pChunk->iUsed += n;
+    return p;
+  }
+#endif
+  return sqlite3DbMallocRaw(db, n);
+}
+
+/*
+** Allocate and zero memory for a parse tree object.
+*/
+void *sqlite3ArenaMallocZero(sqlite3 *db, int n){
+  void *p = sqlite3ArenaMallocRaw(db, n);
+  if( p ){
+    memset(p, 0, n);
+  }
+  return p;
+}
+
+/*
+** Free a single arena chunk. In debug builds, the content is trashed
+** first, so that any use of an object after it is released fails quickly.
+*/
+static void arenaChunkFree(ArenaChunk *pChunk){
+#ifdef SQLITE_DEBUG
+  memset(arenaSpace(pChunk), 0xaa, pChunk->iUsed);
+#endif
+  sqlite3_free(pChunk);
+}
+
+/*
+** Called by sqlite3RunParser() before it begins to parse. The value
+** returned must be passed to the matching sqlite3ArenaEnd() call.
+*/
+ArenaChunk *sqlite3ArenaBegin(sqlite3 *db){
+  db->arena.nDepth++;
+  return db->arena.pChunk;
+}
+
+/*
+** Called by sqlite3RunParser() once all parse tree objects are freed.
+** Chunks allocated since the matching sqlite3ArenaBegin() call are
+** released. Calls to sqlite3RunParser() may nest (for example, when the
+** schema is loaded while another statement is being compiled), so chunks
+** allocated before then are left for the outer call.
+**
+** The oldest chunk is kept for use by the next statement once the
+** outermost call returns, so that preparing a small statement does not
+** require a call to malloc().
+*/
+void sqlite3ArenaEnd(sqlite3 *db, ArenaChunk *pMark){
+  ArenaChunk *pChunk;
+  assert( db->arena.nDepth>0 );
+  db->arena.nDepth--;
+  while( (pChunk = db->arena.pChunk)!=pMark
+      && (db->arena.nDepth>0 || pChunk->pNext)
+  ){
+    db->arena.pChunk = pChunk->pNext;
+    arenaChunkFree(pChunk);
+  }
+  if( db->arena.nDepth==0 && (pChunk = db->arena.pChunk)!=0 ){
+    assert( pChunk->pNext==0 );
+#ifdef SQLITE_DEBUG
+    memset(arenaSpace(pChunk), 0xaa, pChunk->iUsed);
+#endif
+    pChunk->iUsed = 0;
+  }
+}
+
+/*
+** Free the chunk kept by sqlite3ArenaEnd(). Called when the database
+** connection is closed.
+*/
+void sqlite3ArenaClose(sqlite3 *db){
+  ArenaChunk *pChunk;
+  assert( db->arena.nDepth==0 );
+  while( (pChunk = db->arena.pChunk)!=0 ){
+    db->arena.pChunk = pChunk->pNext;
+    arenaChunkFree(pChunk);
+  }
+}
+
 /*
 ** Make a copy of a string in memory obtained from sqliteMalloc(). These 
 ** functions call sqlite3MallocRaw() directly instead of sqliteMalloc(). This
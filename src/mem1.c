@@ -274,6 +274,10 @@ void sqlite3MemSetDefault(void){
      0
   };
   sqlite3_config(SQLITE_CONFIG_MALLOC, &defaultMethods);
+
+  /* The system malloc() is threadsafe, so malloc.c need not serialize
+  ** calls to the methods above. */
+  sqlite3GlobalConfig.bMemThreadsafe = 1;
 }
 
 #endif /* SQLITE_SYSTEM_MALLOC */
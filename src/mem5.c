@@ -83,6 +83,43 @@ struct Mem5Link {
 #define CTRL_LOGSIZE  0x1f    /* Log2 Size of this block */
 #define CTRL_FREE     0x20    /* True if not checked out */
 
+/*
+** If SQLITE_MEMSYS5_CACHE is defined, each of MEM5_NSTRIPE "stripes"
+** caches up to MEM5_NCACHE free blocks of each of the MEM5_NCLASS
+** smallest sizes. A thread allocates from and frees to the stripe selected
+** by the address of its stack, so that threads running at the same time
+** usually use different stripes and do not need mem5.mutex. Blocks are
+** moved between a stripe and the free lists MEM5_NCACHE/2 at a time.
+**
+** Each stripe is protected by a spin-lock that is held only while a
+** block is added or removed, or while a batch of blocks is moved. A
+** thread that finds its stripe locked does not wait for it, but uses
+** the free lists instead.
+**
+** As far as the free lists are concerned, a block in a stripe cache is
+** checked out. The caches are emptied before an allocation is allowed to
+** fail, so that they cannot cause an allocation to fail that would
+** otherwise have succeeded. And they are only used if the heap is at
+** least 64 times as large as the most memory they can hold.
+*/
+#if SQLITE_THREADSAFE && defined(__GNUC__) \
+ && !defined(SQLITE_DISABLE_MEMSYS5_CACHE)
+# define SQLITE_MEMSYS5_CACHE 1
+#endif
+#define MEM5_LOGSTRIPE  3                        /* Log2 of MEM5_NSTRIPE */
+#define MEM5_NSTRIPE    (1<<MEM5_LOGSTRIPE)      /* Number of stripes */
+#define MEM5_NCLASS     4                        /* Block sizes cached */
+#define MEM5_NCACHE     16                       /* Blocks per size */
+
+#ifdef SQLITE_MEMSYS5_CACHE
+typedef struct Mem5Stripe Mem5Stripe;
+struct Mem5Stripe {
+  int lock;                               /* Spin-lock. True if held */
+  int anBlock[MEM5_NCLASS];               /* Number of cached blocks */
+  int aiBlock[MEM5_NCLASS][MEM5_NCACHE];  /* Indexes of cached blocks */
+};
+#endif
+
 /*
 ** All of the static variables used by this module are collected
 ** into a single structure named "mem5".  This is to keep the
@@ -103,7 +140,8 @@ static SQLITE_WSD struct Mem5Global {
   sqlite3_mutex *mutex;
 
   /*
-  ** Performance statistics
+  ** Performance statistics. A block moved to a stripe cache is counted
+  ** as an allocation of the full size of the block.
   */
   u64 nAlloc;         /* Total number of calls to malloc */
   u64 totalAlloc;     /* Total of all malloc calls - includes internal frag */
@@ -127,6 +165,13 @@ static SQLITE_WSD struct Mem5Global {
   */
   u8 *aCtrl;
 
+#ifdef SQLITE_MEMSYS5_CACHE
+  /*
+  ** Caches of small free blocks. Used only if bCache is true.
+  */
+  int bCache;
+  Mem5Stripe aStripe[MEM5_NSTRIPE];
+#endif
 } mem5;
 
 /*
@@ -269,8 +314,6 @@ static void *memsys5MallocUnsafe(int nByte){
   */
   for(iBin=iLogsize; mem5.aiFreelist[iBin]<0 && iBin<=LOGMAX; iBin++){}
   if( iBin>LOGMAX ){
-    testcase( sqlite3GlobalConfig.xLog!=0 );
-    sqlite3_log(SQLITE_NOMEM, "failed to allocate %u bytes", nByte);
     return 0;
   }
   i = memsys5UnlinkFirst(iBin);
@@ -353,15 +396,135 @@ static void memsys5FreeUnsafe(void *pOld){
   memsys5Link(iBlock, iLogsize);
 }
 
+#ifdef SQLITE_MEMSYS5_CACHE
+/*
+** Lock and return the stripe used by the calling thread. Or, if it is
+** already locked, return NULL.
+*/
+static Mem5Stripe *memsys5StripeTry(void){
+  int iStack;
+  u32 h = (u32)SQLITE_PTR_TO_INT(&iStack) >> 16;
+  Mem5Stripe *p = &mem5.aStripe[(h*2654435761U) >> (32-MEM5_LOGSTRIPE)];
+  if( __sync_lock_test_and_set(&p->lock, 1) ) return 0;
+  return p;
+}
+static void memsys5StripeLeave(Mem5Stripe *p){
+  __sync_lock_release(&p->lock);
+}
+
+/*
+** Return a block of (mem5.szAtom<<iLogsize) bytes from the calling
+** thread's stripe cache, first refilling the cache from the free lists
+** if it is empty. Return NULL if the stripe is locked by another thread
+** or no block is available.
+*/
+static void *memsys5CacheMalloc(int iLogsize){
+  Mem5Stripe *p;
+  int iBlock = -1;
+
+  assert( iLogsize>=0 && iLogsize<MEM5_NCLASS );
+  p = memsys5StripeTry();
+  if( p ){
+    int *aiBlock = p->aiBlock[iLogsize];
+    if( p->anBlock[iLogsize]==0 ){
+      u8 *pNew;
+      memsys5Enter();
+      while( p->anBlock[iLogsize]<MEM5_NCACHE/2
+          && (pNew = memsys5MallocUnsafe(mem5.szAtom<<iLogsize))!=0
+      ){
+        aiBlock[p->anBlock[iLogsize]++] = (pNew-mem5.zPool)/mem5.szAtom;
+      }
+      memsys5Leave();
+    }
+    if( p->anBlock[iLogsize]>0 ){
+      iBlock = aiBlock[--p->anBlock[iLogsize]];
+    }
+    memsys5StripeLeave(p);
+  }
+  return iBlock<0 ? 0 : (void*)&mem5.zPool[iBlock*mem5.szAtom];
+}
+
+/*
+** Add block iBlock, of (mem5.szAtom<<iLogsize) bytes, to the calling
+** thread's stripe cache. If the cache is full, first return half of the
+** blocks in it to the free lists. Return zero if successful, or non-zero
+** if the stripe is locked by another thread.
+*/
+static int memsys5CacheFree(int iBlock, int iLogsize){
+  Mem5Stripe *p;
+  int *aiBlock;
+
+  assert( iLogsize>=0 && iLogsize<MEM5_NCLASS );
+  p = memsys5StripeTry();
+  if( p==0 ) return 1;
+  aiBlock = p->aiBlock[iLogsize];
+  if( p->anBlock[iLogsize]==MEM5_NCACHE ){
+    int ii;
+    memsys5Enter();
+    for(ii=0; ii<MEM5_NCACHE/2; ii++){
+      memsys5FreeUnsafe(&mem5.zPool[aiBlock[ii]*mem5.szAtom]);
+    }
+    memsys5Leave();
+    memmove(aiBlock, &aiBlock[MEM5_NCACHE/2], sizeof(int)*MEM5_NCACHE/2);
+    p->anBlock[iLogsize] = MEM5_NCACHE/2;
+  }
+  aiBlock[p->anBlock[iLogsize]++] = iBlock;
+  memsys5StripeLeave(p);
+  return 0;
+}
+
+/*
+** Return all blocks in the stripe caches to the free lists. The caller
+** must not hold mem5.mutex, as a thread holding a stripe lock may be
+** waiting for it.
+*/
+static void memsys5CacheFlush(void){
+  int ii, iLogsize;
+  for(ii=0; ii<MEM5_NSTRIPE; ii++){
+    Mem5Stripe *p = &mem5.aStripe[ii];
+    while( __sync_lock_test_and_set(&p->lock, 1) ){}
+    memsys5Enter();
+    for(iLogsize=0; iLogsize<MEM5_NCLASS; iLogsize++){
+      while( p->anBlock[iLogsize]>0 ){
+        int iBlock = p->aiBlock[iLogsize][--p->anBlock[iLogsize]];
+        memsys5FreeUnsafe(&mem5.zPool[iBlock*mem5.szAtom]);
+      }
+    }
+    memsys5Leave();
+    memsys5StripeLeave(p);
+  }
+}
+#endif /* SQLITE_MEMSYS5_CACHE */
+
 /*
 ** Allocate nBytes of memory
 */
 static void *memsys5Malloc(int nBytes){
   sqlite3_int64 *p = 0;
   if( nBytes>0 ){
+#ifdef SQLITE_MEMSYS5_CACHE
+    if( mem5.bCache && nBytes<=(mem5.szAtom<<(MEM5_NCLASS-1)) ){
+      int iLogsize;
+      for(iLogsize=0; (mem5.szAtom<<iLogsize)<nBytes; iLogsize++){}
+      p = memsys5CacheMalloc(iLogsize);
+      if( p ) return (void*)p;
+    }
+#endif
     memsys5Enter();
     p = memsys5MallocUnsafe(nBytes);
     memsys5Leave();
+#ifdef SQLITE_MEMSYS5_CACHE
+    if( p==0 && mem5.bCache ){
+      memsys5CacheFlush();
+      memsys5Enter();
+      p = memsys5MallocUnsafe(nBytes);
+      memsys5Leave();
+    }
+#endif
+    if( p==0 && nBytes<=0x40000000 ){
+      testcase( sqlite3GlobalConfig.xLog!=0 );
+      sqlite3_log(SQLITE_NOMEM, "failed to allocate %u bytes", nBytes);
+    }
   }
   return (void*)p; 
 }
@@ -374,6 +537,17 @@ static void *memsys5Malloc(int nBytes){
 */
 static void memsys5Free(void *pPrior){
   assert( pPrior!=0 );
+#ifdef SQLITE_MEMSYS5_CACHE
+  if( mem5.bCache ){
+    /* The control byte of a checked out block is not modified by other
+    ** threads, so it may be read without holding mem5.mutex. */
+    int iBlock = ((u8 *)pPrior-mem5.zPool)/mem5.szAtom;
+    int iLogsize = mem5.aCtrl[iBlock] & CTRL_LOGSIZE;
+    if( iLogsize<MEM5_NCLASS && memsys5CacheFree(iBlock, iLogsize)==0 ){
+      return;
+    }
+  }
+#endif
   memsys5Enter();
   memsys5FreeUnsafe(pPrior);
   memsys5Leave();  
@@ -404,13 +578,11 @@ static void *memsys5Realloc(void *pPrior, int nBytes){
   if( nBytes<=nOld ){
     return pPrior;
   }
-  memsys5Enter();
-  p = memsys5MallocUnsafe(nBytes);
+  p = memsys5Malloc(nBytes);
   if( p ){
     memcpy(p, pPrior, nOld);
-    memsys5FreeUnsafe(pPrior);
+    memsys5Free(pPrior);
   }
-  memsys5Leave();
   return p;
 }
 
@@ -480,38 +652,68 @@ static int memsys5Init(void *NotUsed){
     mem5.szAtom = mem5.szAtom << 1;
   }
 
-  mem5.nBlock = (nByte / (mem5.szAtom+sizeof(u8)));
-  mem5.zPool = zByte;
-  mem5.aCtrl = (u8 *)&mem5.zPool[mem5.nBlock*mem5.szAtom];
-
-  for(ii=0; ii<=LOGMAX; ii++){
-    mem5.aiFreelist[ii] = -1;
-  }
+  /* If the allocator is being initialized again after a call to
+  ** sqlite3_shutdown() and the heap has not been reconfigured in the
+  ** meantime, leave the free lists as they are. Applications sometimes
+  ** call sqlite3_shutdown() while objects allocated from the heap (for
+  ** example the unix VFS inode list) are still in use. Partitioning the
+  ** heap afresh would hand out their memory again.  */
+  if( mem5.zPool!=zByte
+   || mem5.nBlock!=(int)(nByte / (mem5.szAtom+sizeof(u8)))
+  ){
+    mem5.nBlock = (nByte / (mem5.szAtom+sizeof(u8)));
+    mem5.zPool = zByte;
+    mem5.aCtrl = (u8 *)&mem5.zPool[mem5.nBlock*mem5.szAtom];
+
+    for(ii=0; ii<=LOGMAX; ii++){
+      mem5.aiFreelist[ii] = -1;
+    }
 
-  iOffset = 0;
-  for(ii=LOGMAX; ii>=0; ii--){
-    int nAlloc = (1<<ii);
-    if( (iOffset+nAlloc)<=mem5.nBlock ){
-      mem5.aCtrl[iOffset] = ii | CTRL_FREE;
-      memsys5Link(iOffset, ii);
-      iOffset += nAlloc;
+    iOffset = 0;
+    for(ii=LOGMAX; ii>=0; ii--){
+      int nAlloc = (1<<ii);
+      if( (iOffset+nAlloc)<=mem5.nBlock ){
+        mem5.aCtrl[iOffset] = ii | CTRL_FREE;
+        memsys5Link(iOffset, ii);
+        iOffset += nAlloc;
+      }
+      assert((iOffset+nAlloc)>mem5.nBlock);
     }
-    assert((iOffset+nAlloc)>mem5.nBlock);
   }
 
-  /* If a mutex is required for normal operation, allocate one */
-  if( sqlite3GlobalConfig.bMemstat==0 ){
+  /* If a mutex is required for normal operation, allocate one. If the
+  ** memory statistics are updated using atomic operations, malloc.c does
+  ** not serialize calls to this allocator (see bMemThreadsafe), and never
+  ** holds the STATIC_MEM mutex while calling it.  */
+  if( sqlite3GlobalConfig.bMemstat==0
+#ifdef SQLITE_STATUS_ATOMIC
+   || sqlite3GlobalConfig.bMemThreadsafe
+#endif
+  ){
     mem5.mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MEM);
   }
 
+#ifdef SQLITE_MEMSYS5_CACHE
+  memset(mem5.aStripe, 0, sizeof(mem5.aStripe));
+  mem5.bCache = mem5.mutex!=0 && mem5.nBlock/64 >=
+      MEM5_NSTRIPE * MEM5_NCACHE * ((1<<MEM5_NCLASS)-1);
+#endif
+
   return SQLITE_OK;
 }
 
 /*
-** Deinitialize this module.
+** Deinitialize this module. Blocks in the stripe caches are returned to
+** the free lists, as the heap may be reused by the next memsys5Init().
 */
 static void memsys5Shutdown(void *NotUsed){
   UNUSED_PARAMETER(NotUsed);
+#ifdef SQLITE_MEMSYS5_CACHE
+  if( mem5.bCache ){
+    memsys5CacheFlush();
+    mem5.bCache = 0;
+  }
+#endif
   mem5.mutex = 0;
   return;
 }
@@ -542,6 +744,12 @@ void sqlite3Memsys5Dump(const char *zFilename){
     for(n=0, j=mem5.aiFreelist[i]; j>=0; j = MEM5LINK(j)->next, n++){}
     fprintf(out, "freelist items of size %d: %d\n", mem5.szAtom << i, n);
   }
+#ifdef SQLITE_MEMSYS5_CACHE
+  for(i=0; i<MEM5_NCLASS; i++){
+    for(n=0, j=0; j<MEM5_NSTRIPE; j++) n += mem5.aStripe[j].anBlock[i];
+    fprintf(out, "cached items of size %d: %d\n", mem5.szAtom << i, n);
+  }
+#endif
   fprintf(out, "mem5.nAlloc       = %llu\n", mem5.nAlloc);
   fprintf(out, "mem5.totalAlloc   = %llu\n", mem5.totalAlloc);
   fprintf(out, "mem5.totalExcess  = %llu\n", mem5.totalExcess);
@@ -563,6 +771,11 @@ void sqlite3Memsys5Dump(const char *zFilename){
 ** This routine is the only routine in this file with external 
 ** linkage. It returns a pointer to a static sqlite3_mem_methods
 ** struct populated with the memsys5 methods.
+**
+** It is called whenever a heap is configured using SQLITE_CONFIG_HEAP.
+** Clearing mem5.zPool causes the next memsys5Init() to partition the
+** new heap from scratch, even if it happens to occupy the same memory
+** as the previous one.
 */
 const sqlite3_mem_methods *sqlite3MemGetMemsys5(void){
   static const sqlite3_mem_methods memsys5Methods = {
@@ -575,6 +788,7 @@ const sqlite3_mem_methods *sqlite3MemGetMemsys5(void){
      memsys5Shutdown,
      0
   };
+  mem5.zPool = 0;
   return &memsys5Methods;
 }
 
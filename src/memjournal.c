@@ -232,7 +232,8 @@ static const struct sqlite3_io_methods MemJournalMethods = {
   0,                /* xShmBarrier */
   0,                /* xShmUnmap */
   0,                /* xFetch */
-  0                 /* xUnfetch */
+  0,                /* xUnfetch */
+  0                 /* xWritev */
 };
 
 /* 
@@ -35,11 +35,39 @@
 # define SQLITE_MUTEX_NREF 0
 #endif
 
+/*
+** If SQLITE_MUTEX_SPIN is greater than zero, a thread that finds a mutex
+** held by another thread retries for a while before blocking, in case
+** the mutex is released soon. The number of retries adapts to the
+** number that were required by recent callers, up to a maximum of
+** SQLITE_MUTEX_SPIN. This helps when critical sections are very short,
+** but only wastes CPU time on a single-core system, so it is disabled
+** by default.
+*/
+#ifndef SQLITE_MUTEX_SPIN
+# define SQLITE_MUTEX_SPIN 0
+#endif
+
 /*
 ** Each recursive mutex is an instance of the following structure.
+**
+** If pRw is not NULL, the mutex is a shared/exclusive lock. In this case
+** sqlite3_mutex_enter() and the other methods obtain an exclusive lock
+** on *pRw, and sqlite3MutexEnterShared() a shared lock. The mutex field
+** is not used. This is only ever true of SQLITE_MUTEX_STATIC_MASTER.
+**
+** The nEnter and nWait fields count the number of times the mutex has
+** been entered, and the number of those times it was held by another
+** thread at first. They are only modified while holding the mutex.
 */
 struct sqlite3_mutex {
   pthread_mutex_t mutex;     /* Mutex controlling the lock */
+  pthread_rwlock_t *pRw;     /* Shared/exclusive lock, or NULL */
+  u32 nEnter;                /* Number of times the mutex was entered */
+  u32 nWait;                 /* Number of times a caller had to wait */
+#if SQLITE_MUTEX_SPIN>0
+  int nSpin;                 /* Recent average number of retries */
+#endif
 #if SQLITE_MUTEX_NREF
   int id;                    /* Mutex type */
   volatile int nRef;         /* Number of entrances */
@@ -47,10 +75,17 @@ struct sqlite3_mutex {
   int trace;                 /* True to trace changes */
 #endif
 };
+#if SQLITE_MUTEX_SPIN>0
+# define SQLITE3_MUTEX_SPIN_INIT 0,
+#else
+# define SQLITE3_MUTEX_SPIN_INIT
+#endif
 #if SQLITE_MUTEX_NREF
-#define SQLITE3_MUTEX_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, 0, 0, (pthread_t)0, 0 }
+#define SQLITE3_MUTEX_INITIALIZER(pRw) { PTHREAD_MUTEX_INITIALIZER, pRw, 0, 0, \
+    SQLITE3_MUTEX_SPIN_INIT 0, 0, (pthread_t)0, 0 }
 #else
-#define SQLITE3_MUTEX_INITIALIZER { PTHREAD_MUTEX_INITIALIZER }
+#define SQLITE3_MUTEX_INITIALIZER(pRw) { PTHREAD_MUTEX_INITIALIZER, pRw, 0, 0, \
+    SQLITE3_MUTEX_SPIN_INIT }
 #endif
 
 /*
@@ -127,13 +162,14 @@ static int pthreadMutexEnd(void){ return SQLITE_OK; }
 ** the same type number.
 */
 static sqlite3_mutex *pthreadMutexAlloc(int iType){
+  static pthread_rwlock_t masterRw = PTHREAD_RWLOCK_INITIALIZER;
   static sqlite3_mutex staticMutexes[] = {
-    SQLITE3_MUTEX_INITIALIZER,
-    SQLITE3_MUTEX_INITIALIZER,
-    SQLITE3_MUTEX_INITIALIZER,
-    SQLITE3_MUTEX_INITIALIZER,
-    SQLITE3_MUTEX_INITIALIZER,
-    SQLITE3_MUTEX_INITIALIZER
+    SQLITE3_MUTEX_INITIALIZER(&masterRw),
+    SQLITE3_MUTEX_INITIALIZER(0),
+    SQLITE3_MUTEX_INITIALIZER(0),
+    SQLITE3_MUTEX_INITIALIZER(0),
+    SQLITE3_MUTEX_INITIALIZER(0),
+    SQLITE3_MUTEX_INITIALIZER(0)
   };
   sqlite3_mutex *p;
   switch( iType ){
@@ -194,6 +230,54 @@ static void pthreadMutexFree(sqlite3_mutex *p){
   sqlite3_free(p);
 }
 
+/*
+** Block until the underlying pthreads mutex or exclusive lock of p is
+** obtained. If SQLITE_MUTEX_SPIN is greater than zero, retry a number of
+** times before blocking. Update the statistics for p.
+*/
+static void pthreadMutexLock(sqlite3_mutex *p){
+  int rc;
+  if( p->pRw ){
+    rc = pthread_rwlock_trywrlock(p->pRw);
+  }else{
+    rc = pthread_mutex_trylock(&p->mutex);
+  }
+  if( rc ){
+#if SQLITE_MUTEX_SPIN>0
+    int nMax = p->nSpin*2 + 10;
+    int n = 0;
+    if( nMax>SQLITE_MUTEX_SPIN ) nMax = SQLITE_MUTEX_SPIN;
+    do{
+      if( n++>=nMax ){
+        rc = 0;
+        break;
+      }
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+      __asm__ __volatile__ ("pause");
+#endif
+      if( p->pRw ){
+        rc = pthread_rwlock_trywrlock(p->pRw);
+      }else{
+        rc = pthread_mutex_trylock(&p->mutex);
+      }
+    }while( rc );
+    if( n>nMax )
+#endif
+    {
+      if( p->pRw ){
+        pthread_rwlock_wrlock(p->pRw);
+      }else{
+        pthread_mutex_lock(&p->mutex);
+      }
+    }
+#if SQLITE_MUTEX_SPIN>0
+    p->nSpin += (n - p->nSpin)/8;
+#endif
+    p->nWait++;
+  }
+  p->nEnter++;
+}
+
 /*
 ** The sqlite3_mutex_enter() and sqlite3_mutex_try() routines attempt
 ** to enter a mutex.  If another thread is already within the mutex,
@@ -224,7 +308,7 @@ static void pthreadMutexEnter(sqlite3_mutex *p){
     if( p->nRef>0 && pthread_equal(p->owner, self) ){
       p->nRef++;
     }else{
-      pthread_mutex_lock(&p->mutex);
+      pthreadMutexLock(p);
       assert( p->nRef==0 );
       p->owner = self;
       p->nRef = 1;
@@ -233,7 +317,7 @@ static void pthreadMutexEnter(sqlite3_mutex *p){
 #else
   /* Use the built-in recursive mutexes if they are available.
   */
-  pthread_mutex_lock(&p->mutex);
+  pthreadMutexLock(p);
 #if SQLITE_MUTEX_NREF
   assert( p->nRef>0 || p->owner==0 );
   p->owner = pthread_self();
@@ -267,8 +351,10 @@ static int pthreadMutexTry(sqlite3_mutex *p){
     if( p->nRef>0 && pthread_equal(p->owner, self) ){
       p->nRef++;
       rc = SQLITE_OK;
-    }else if( pthread_mutex_trylock(&p->mutex)==0 ){
+    }else if( (p->pRw ? pthread_rwlock_trywrlock(p->pRw)
+                      : pthread_mutex_trylock(&p->mutex))==0 ){
       assert( p->nRef==0 );
+      p->nEnter++;
       p->owner = self;
       p->nRef = 1;
       rc = SQLITE_OK;
@@ -279,7 +365,9 @@ static int pthreadMutexTry(sqlite3_mutex *p){
 #else
   /* Use the built-in recursive mutexes if they are available.
   */
-  if( pthread_mutex_trylock(&p->mutex)==0 ){
+  if( (p->pRw ? pthread_rwlock_trywrlock(p->pRw)
+              : pthread_mutex_trylock(&p->mutex))==0 ){
+    p->nEnter++;
 #if SQLITE_MUTEX_NREF
     p->owner = pthread_self();
     p->nRef++;
@@ -313,12 +401,15 @@ static void pthreadMutexLeave(sqlite3_mutex *p){
   assert( p->nRef==0 || p->id==SQLITE_MUTEX_RECURSIVE );
 
 #ifdef SQLITE_HOMEGROWN_RECURSIVE_MUTEX
-  if( p->nRef==0 ){
-    pthread_mutex_unlock(&p->mutex);
-  }
-#else
-  pthread_mutex_unlock(&p->mutex);
+  if( p->nRef==0 )
 #endif
+  {
+    if( p->pRw ){
+      pthread_rwlock_unlock(p->pRw);
+    }else{
+      pthread_mutex_unlock(&p->mutex);
+    }
+  }
 
 #ifdef SQLITE_DEBUG
   if( p->trace ){
@@ -327,6 +418,54 @@ static void pthreadMutexLeave(sqlite3_mutex *p){
 #endif
 }
 
+/*
+** Enter mutex p in shared mode. Any number of threads may hold the same
+** mutex in shared mode at once, but not while another thread holds it
+** through sqlite3_mutex_enter(). A thread that holds a mutex in shared
+** mode must not attempt to enter it again in any mode.
+**
+** Only shared/exclusive mutexes created by this implementation actually
+** support shared mode. Others, including all mutexes if an application
+** defined mutex implementation is in use, are entered as usual. The
+** implementation is checked first, since p may not be a sqlite3_mutex
+** of this file at all.
+*/
+void sqlite3MutexEnterShared(sqlite3_mutex *p){
+  if( p==0 ) return;
+  if( sqlite3GlobalConfig.mutex.xMutexEnter!=pthreadMutexEnter || p->pRw==0 ){
+    sqlite3_mutex_enter(p);
+  }else{
+    assert( pthreadMutexNotheld(p) );
+    if( pthread_rwlock_tryrdlock(p->pRw) ){
+      pthread_rwlock_rdlock(p->pRw);
+    }
+  }
+}
+void sqlite3MutexLeaveShared(sqlite3_mutex *p){
+  if( p==0 ) return;
+  if( sqlite3GlobalConfig.mutex.xMutexEnter!=pthreadMutexEnter || p->pRw==0 ){
+    sqlite3_mutex_leave(p);
+  }else{
+    pthread_rwlock_unlock(p->pRw);
+  }
+}
+
+/*
+** If mutex p was created by this implementation, set *pnEnter to the
+** number of times it has been entered and *pnWait to the number of those
+** times the caller had to wait for another thread to leave it, and
+** return non-zero. Entries in shared mode are not counted. Otherwise,
+** return zero.
+*/
+int sqlite3MutexStats(sqlite3_mutex *p, u32 *pnEnter, u32 *pnWait){
+  if( p==0 || sqlite3GlobalConfig.mutex.xMutexEnter!=pthreadMutexEnter ){
+    return 0;
+  }
+  *pnEnter = p->nEnter;
+  *pnWait = p->nWait;
+  return 1;
+}
+
 sqlite3_mutex_methods const *sqlite3DefaultMutex(void){
   static const sqlite3_mutex_methods sMutex = {
     pthreadMutexInit,
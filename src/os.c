@@ -75,6 +75,29 @@ int sqlite3OsWrite(sqlite3_file *id, const void *pBuf, int amt, i64 offset){
   DO_OS_MALLOC_TEST(id);
   return id->pMethods->xWrite(id, pBuf, amt, offset);
 }
+/*
+** Write nBuf buffers of amt bytes each to consecutive locations of file
+** id, starting at offset.  If the VFS does not provide an xWritev method,
+** the buffers are written one at a time using xWrite.
+*/
+int sqlite3OsWritev(
+  sqlite3_file *id,
+  int nBuf,
+  const void **apBuf,
+  int amt,
+  i64 offset
+){
+  int rc = SQLITE_OK;
+  int i;
+  if( id->pMethods->iVersion>=4 && id->pMethods->xWritev ){
+    DO_OS_MALLOC_TEST(id);
+    return id->pMethods->xWritev(id, nBuf, apBuf, amt, offset);
+  }
+  for(i=0; rc==SQLITE_OK && i<nBuf; i++){
+    rc = sqlite3OsWrite(id, apBuf[i], amt, offset + i*(i64)amt);
+  }
+  return rc;
+}
 int sqlite3OsTruncate(sqlite3_file *id, i64 size){
   return id->pMethods->xTruncate(id, size);
 }
@@ -307,12 +330,12 @@ sqlite3_vfs *sqlite3_vfs_find(const char *zVfs){
 #if SQLITE_THREADSAFE
   mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MASTER);
 #endif
-  sqlite3_mutex_enter(mutex);
+  sqlite3MutexEnterShared(mutex);
   for(pVfs = vfsList; pVfs; pVfs=pVfs->pNext){
     if( zVfs==0 ) break;
     if( strcmp(zVfs, pVfs->zName)==0 ) break;
   }
-  sqlite3_mutex_leave(mutex);
+  sqlite3MutexLeaveShared(mutex);
   return pVfs;
 }
 
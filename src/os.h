@@ -230,6 +230,20 @@
 */
 int sqlite3OsInit(void);
 
+/*
+** Allocate and free the page-cache arena directly from the OS, so that
+** it can be backed by huge pages.
+*/
+#ifdef SQLITE_ENABLE_HUGEPAGE
+# if SQLITE_OS_UNIX
+void *sqlite3OsHugeAlloc(sqlite3_int64);
+void sqlite3OsHugeFree(void*, sqlite3_int64);
+# else
+#  define sqlite3OsHugeAlloc(N) 0
+#  define sqlite3OsHugeFree(P,N)
+# endif
+#endif
+
 /* 
 ** Functions for accessing sqlite3_file methods 
 */
@@ -253,6 +267,7 @@ void sqlite3OsShmBarrier(sqlite3_file *id);
 int sqlite3OsShmUnmap(sqlite3_file *id, int);
 int sqlite3OsFetch(sqlite3_file *id, i64, int, void **);
 int sqlite3OsUnfetch(sqlite3_file *, i64, void *);
+int sqlite3OsWritev(sqlite3_file*, int, const void**, int, i64);
 
 
 /* 
@@ -53,6 +53,20 @@
 # define HAVE_POSIX_FALLOCATE 1
 #endif
 
+/* Use posix_fadvise() if it is available
+*/
+#if !defined(HAVE_POSIX_FADVISE) \
+      && (_XOPEN_SOURCE >= 600 || _POSIX_C_SOURCE >= 200112L)
+# define HAVE_POSIX_FADVISE 1
+#endif
+
+/* Use sync_file_range() if it is available
+*/
+#if !defined(HAVE_SYNC_FILE_RANGE) && defined(__linux__) \
+      && defined(_GNU_SOURCE)
+# define HAVE_SYNC_FILE_RANGE 1
+#endif
+
 /*
 ** There are various methods for file locking used for concurrency
 ** control:
@@ -130,6 +144,16 @@
 #include <sys/mman.h>
 #endif
 
+/*
+** Direct I/O is available if the system defines O_DIRECT. Reads and
+** writes on a file opened for direct I/O must use file offsets, sizes
+** and buffer addresses that are multiples of UNIX_DIRECT_ALIGN bytes.
+*/
+#if defined(O_DIRECT) && !defined(SQLITE_DISABLE_DIRECT_IO)
+# define UNIX_DIRECT_IO_ENABLED 1
+# define UNIX_DIRECT_ALIGN 4096
+#endif
+
 
 #if SQLITE_ENABLE_LOCKING_STYLE
 # include <sys/ioctl.h>
@@ -230,6 +254,11 @@ struct unixFile {
   sqlite3_int64 mmapSizeActual;       /* Actual size of mapping at pMapRegion */
   sqlite3_int64 mmapSizeMax;          /* Configured FCNTL_MMAP_SIZE value */
   void *pMapRegion;                   /* Memory mapped region */
+#ifdef UNIX_DIRECT_IO_ENABLED
+  u8 *aDirect;                        /* Aligned buffer for direct I/O */
+  void *pDirect;                      /* Allocation containing aDirect[] */
+  int nDirect;                        /* Size of aDirect[] in bytes */
+#endif
 #ifdef __QNXNTO__
   int sectorSize;                     /* Device sector size */
   int deviceCharacteristics;          /* Precomputed device characteristics */
@@ -281,6 +310,7 @@ struct unixFile {
 #define UNIXFILE_URI         0x40     /* Filename might have query parameters */
 #define UNIXFILE_NOLOCK      0x80     /* Do no file locking */
 #define UNIXFILE_WARNED    0x0100     /* verifyDbFile() warnings have been issued */
+#define UNIXFILE_DIRECT    0x0200     /* File descriptor uses O_DIRECT */
 
 /*
 ** Include code that is common to all os_*.c files
@@ -325,6 +355,20 @@ struct unixFile {
 # endif
 #endif
 
+/*
+** HAVE_PWRITEV defaults to true on Linux and false everywhere else.
+*/
+#if !defined(HAVE_PWRITEV)
+# if defined(__linux__)
+#  define HAVE_PWRITEV 1
+# else
+#  define HAVE_PWRITEV 0
+# endif
+#endif
+#if HAVE_PWRITEV
+# include <sys/uio.h>
+#endif
+
 /*
 ** Different Unix systems declare open() in different ways.  Same use
 ** open(const char*,int,mode_t).  Others use open(const char*,int,...).
@@ -469,6 +513,14 @@ static struct unix_syscall {
 #endif
 #define osMremap ((void*(*)(void*,size_t,size_t,int,...))aSyscall[23].pCurrent)
 
+#if HAVE_PWRITEV
+  { "pwritev",      (sqlite3_syscall_ptr)pwritev,         0 },
+#else
+  { "pwritev",      (sqlite3_syscall_ptr)0,               0 },
+#endif
+#define osPwritev ((ssize_t(*)(int,const struct iovec*,int,off_t))\
+                  aSyscall[24].pCurrent)
+
 }; /* End of the overrideable system calls */
 
 /*
@@ -1910,6 +1962,9 @@ static int closeUnixFile(sqlite3_file *id){
   OSTRACE(("CLOSE   %-3d\n", pFile->h));
   OpenCounter(-1);
   sqlite3_free(pFile->pUnused);
+#ifdef UNIX_DIRECT_IO_ENABLED
+  sqlite3_free(pFile->pDirect);
+#endif
   memset(pFile, 0, sizeof(unixFile));
   return SQLITE_OK;
 }
@@ -3077,6 +3132,16 @@ static int nfsUnlock(sqlite3_file *id, int eFileLock){
 ** are gather together into this division.
 */
 
+#ifdef UNIX_DIRECT_IO_ENABLED
+/*
+** Return true if n bytes may be read or written at offset iOff using
+** buffer p on a file opened for direct I/O.
+*/
+#define unixDirectAligned(iOff, p, n) \
+  ((((iOff) | (n) | SQLITE_PTR_TO_INT(p)) & (UNIX_DIRECT_ALIGN-1))==0)
+static int unixDirectIo(unixFile*, int, i64, void*, int);
+#endif
+
 /*
 ** Seek to the offset passed as the second argument, then read cnt 
 ** bytes into pBuf. Return the number of bytes actually read.
@@ -3095,6 +3160,13 @@ static int seekAndRead(unixFile *id, sqlite3_int64 offset, void *pBuf, int cnt){
   int prior = 0;
 #if (!defined(USE_PREAD) && !defined(USE_PREAD64))
   i64 newOffset;
+#endif
+#ifdef UNIX_DIRECT_IO_ENABLED
+  if( (id->ctrlFlags & UNIXFILE_DIRECT) 
+   && !unixDirectAligned(offset, pBuf, cnt) 
+  ){
+    return unixDirectIo(id, 0, offset, pBuf, cnt);
+  }
 #endif
   TIMER_START;
   assert( cnt==(cnt&0x1ffff) );
@@ -3248,9 +3320,108 @@ static int seekAndWriteFd(
 ** is set before returning.
 */
 static int seekAndWrite(unixFile *id, i64 offset, const void *pBuf, int cnt){
+#ifdef UNIX_DIRECT_IO_ENABLED
+  if( (id->ctrlFlags & UNIXFILE_DIRECT) 
+   && !unixDirectAligned(offset, pBuf, cnt) 
+  ){
+    return unixDirectIo(id, 1, offset, (void*)pBuf, cnt);
+  }
+#endif
   return seekAndWriteFd(id->h, offset, pBuf, cnt, &id->lastErrno);
 }
 
+#ifdef UNIX_DIRECT_IO_ENABLED
+/*
+** Stop using direct I/O for file pFile. O_DIRECT is cleared on the file
+** descriptor and all further I/O passes through the OS cache.
+*/
+static void unixDirectClear(unixFile *pFile){
+  int flags = osFcntl(pFile->h, F_GETFL);
+  if( flags>=0 ) osFcntl(pFile->h, F_SETFL, flags & ~O_DIRECT);
+  pFile->ctrlFlags &= ~UNIXFILE_DIRECT;
+}
+
+/*
+** Read or write nBuf bytes at offset iOff of a file opened for direct
+** I/O, where the offset, size or buffer is not suitably aligned. The
+** return value is as for seekAndRead() or seekAndWrite().
+**
+** The data is copied through an aligned buffer allocated for the file.
+** A read of less than 512 bytes (the smallest page size) that does not
+** start and end on aligned offsets reads the aligned range containing
+** it. This is the case for reads of the database header fields.
+**
+** Any other access that is not aligned is a page of a database with a
+** page size smaller than UNIX_DIRECT_ALIGN. Direct I/O is not used for
+** such databases, so it is turned off for the file by unixDirectClear().
+** The same is done if the aligned buffer cannot be allocated.
+*/
+static int unixDirectIo(
+  unixFile *pFile,                /* File to read or write */
+  int bWrite,                     /* True to write, false to read */
+  i64 iOff,                       /* Offset to read or write at */
+  void *pBuf,                     /* Buffer to read into or write from */
+  int nBuf                        /* Bytes to read or write */
+){
+  i64 iStart = iOff & ~(i64)(UNIX_DIRECT_ALIGN-1);
+  int iSkip = (int)(iOff - iStart);
+  int nAligned = (iSkip + nBuf + UNIX_DIRECT_ALIGN-1) & ~(UNIX_DIRECT_ALIGN-1);
+  int rc;
+
+  assert( pFile->ctrlFlags & UNIXFILE_DIRECT );
+  if( nAligned!=nBuf && (bWrite || nBuf>=512) ){
+    unixDirectClear(pFile);
+  }else if( nAligned>pFile->nDirect ){
+    void *pNew = sqlite3_malloc(nAligned + UNIX_DIRECT_ALIGN);
+    if( pNew ){
+      sqlite3_free(pFile->pDirect);
+      pFile->pDirect = pNew;
+      pFile->aDirect = (u8*)pNew + UNIX_DIRECT_ALIGN 
+                     - (SQLITE_PTR_TO_INT(pNew) & (UNIX_DIRECT_ALIGN-1));
+      pFile->nDirect = nAligned;
+    }else{
+      unixDirectClear(pFile);
+    }
+  }
+
+  if( (pFile->ctrlFlags & UNIXFILE_DIRECT)==0 ){
+    if( bWrite ){
+      rc = seekAndWrite(pFile, iOff, pBuf, nBuf);
+    }else{
+      rc = seekAndRead(pFile, iOff, pBuf, nBuf);
+    }
+  }else if( bWrite ){
+    assert( iSkip==0 && nAligned==nBuf );
+    memcpy(pFile->aDirect, pBuf, nBuf);
+    rc = seekAndWrite(pFile, iOff, pFile->aDirect, nBuf);
+  }else{
+    rc = seekAndRead(pFile, iStart, pFile->aDirect, nAligned);
+    if( rc>0 ){
+      rc = (rc<=iSkip) ? 0 : (rc-iSkip<nBuf ? rc-iSkip : nBuf);
+      memcpy(pBuf, &pFile->aDirect[iSkip], rc);
+    }
+  }
+  return rc;
+}
+
+/*
+** Enable or disable direct I/O on file descriptor fd according to the
+** value of the "direct" URI parameter in zPath. Return true if direct
+** I/O is enabled, or false otherwise. Not all file-systems support
+** direct I/O. If it cannot be enabled, the file is used as normal.
+*/
+static int unixDirectOpen(int fd, const char *zPath){
+  int bDirect = sqlite3_uri_boolean(zPath, "direct", 0);
+  int flags = osFcntl(fd, F_GETFL);
+  if( flags<0 ) return 0;
+  if( bDirect!=((flags & O_DIRECT)!=0) ){
+    int newFlags = bDirect ? (flags|O_DIRECT) : (flags&~O_DIRECT);
+    if( osFcntl(fd, F_SETFL, newFlags)==0 ) flags = newFlags;
+  }
+  return (flags & O_DIRECT)!=0;
+}
+#endif /* UNIX_DIRECT_IO_ENABLED */
+
 
 /*
 ** Write data from a buffer into a file.  Return SQLITE_OK on success
@@ -3336,6 +3507,128 @@ static int unixWrite(
   return SQLITE_OK;
 }
 
+#if HAVE_PWRITEV
+/*
+** The maximum number of buffers passed to a single pwritev() call.
+*/
+#define UNIX_WRITEV_MAX 64
+
+/*
+** Write nBuf buffers of amt bytes each to consecutive locations in the
+** file, starting at offset.  This is the xWritev method. Each group of
+** up to UNIX_WRITEV_MAX buffers is written with a single pwritev() call.
+**
+** Buffers that lie within the memory mapping are written by unixWrite(),
+** as are buffers that are not aligned on a file opened for direct I/O.
+** Otherwise this function only uses positioned writes, so it may be
+** called by more than one thread at a time (see the
+** SQLITE_FCNTL_PARALLEL_WRITE file control).
+*/
+static int unixWritev(
+  sqlite3_file *id,
+  int nBuf,
+  const void **apBuf,
+  int amt,
+  sqlite3_int64 offset
+){
+  unixFile *pFile = (unixFile*)id;
+  struct iovec aIov[UNIX_WRITEV_MAX];
+  int rc = SQLITE_OK;
+  assert( id );
+  assert( amt>0 );
+
+  while( rc==SQLITE_OK && nBuf>0 ){
+    int bSingle = 0;
+    int n;                        /* Number of buffers in this group */
+    i64 nByte;                    /* Number of bytes in this group */
+    i64 nDone;                    /* Bytes of this group written so far */
+    ssize_t wrote;                /* Value returned by pwritev() */
+    int i;
+
+#if SQLITE_MAX_MMAP_SIZE>0
+    /* Copy buffers that lie wholly within the mapping using memcpy() */
+    if( offset+amt<=pFile->mmapSize ) bSingle = 1;
+#endif
+#ifdef SQLITE_DEBUG
+    /* Let unixWrite() check for changes to the transaction counter */
+    if( pFile->inNormalWrite && offset<=24 ) bSingle = 1;
+#endif
+#ifdef UNIX_DIRECT_IO_ENABLED
+    /* Let seekAndWrite() deal with buffers not aligned for direct I/O */
+    if( (pFile->ctrlFlags & UNIXFILE_DIRECT)
+     && !unixDirectAligned(offset, apBuf[0], amt)
+    ){
+      bSingle = 1;
+    }
+#endif
+    if( bSingle ){
+      rc = unixWrite(id, apBuf[0], amt, offset);
+      apBuf++;
+      nBuf--;
+      offset += amt;
+      continue;
+    }
+
+#ifdef SQLITE_DEBUG
+    if( pFile->inNormalWrite ) pFile->dbUpdate = 1;
+#endif
+    n = (nBuf<UNIX_WRITEV_MAX ? nBuf : UNIX_WRITEV_MAX);
+#ifdef UNIX_DIRECT_IO_ENABLED
+    /* For direct I/O, the group ends before the first unaligned buffer */
+    if( pFile->ctrlFlags & UNIXFILE_DIRECT ){
+      for(i=1; i<n && unixDirectAligned(0, apBuf[i], amt); i++);
+      n = i;
+    }
+#endif
+    nByte = n*(i64)amt;
+    for(i=0; i<n; i++){
+      aIov[i].iov_base = (void*)apBuf[i];
+      aIov[i].iov_len = amt;
+    }
+    for(i=0, nDone=0; nDone<nByte; nDone+=wrote){
+      TIMER_START;
+      do{
+        wrote = osPwritev(pFile->h, &aIov[i], n-i, offset+nDone);
+      }while( wrote<0 && errno==EINTR );
+      TIMER_END;
+      OSTRACE(("WRITEV  %-3d %5d %7lld %llu\n",
+               pFile->h, (int)wrote, offset+nDone, TIMER_ELAPSED));
+      if( wrote<0 ) pFile->lastErrno = errno;
+      SimulateIOError(( wrote=(-1) ));
+      SimulateDiskfullError(( wrote=0 ));
+
+      if( wrote<=0 ){
+        if( wrote<0 && pFile->lastErrno!=ENOSPC ){
+          return SQLITE_IOERR_WRITE;
+        }
+        pFile->lastErrno = 0; /* not a system error */
+        return SQLITE_FULL;
+      }
+      assert( nDone+wrote<=nByte );
+
+      /* After a short write, skip over the buffers (and the part of a 
+      ** buffer) already written and continue with the rest */
+      if( nDone+wrote<nByte ){
+        ssize_t nSkip = wrote;
+        while( nSkip>=(ssize_t)aIov[i].iov_len ){
+          nSkip -= aIov[i].iov_len;
+          i++;
+        }
+        aIov[i].iov_base = (void*)&((u8*)aIov[i].iov_base)[nSkip];
+        aIov[i].iov_len -= nSkip;
+      }
+    }
+    apBuf += n;
+    nBuf -= n;
+    offset += nByte;
+  }
+
+  return rc;
+}
+#else
+# define unixWritev 0
+#endif /* HAVE_PWRITEV */
+
 #ifdef SQLITE_TEST
 /*
 ** Count the number of fullsyncs and normal syncs.  This is used to test
@@ -3684,6 +3977,11 @@ static int fcntlSizeHint(unixFile *pFile, i64 nByte){
         return unixLogError(SQLITE_IOERR_TRUNCATE, "ftruncate", pFile->zPath);
       }
       iWrite = ((buf.st_size + 2*nBlk - 1)/nBlk)*nBlk-1;
+#ifdef UNIX_DIRECT_IO_ENABLED
+      /* Single bytes cannot be written to a file opened for direct I/O.
+      ** The file is extended by the ftruncate() only. */
+      if( pFile->ctrlFlags & UNIXFILE_DIRECT ) iWrite = nSize;
+#endif
       while( iWrite<nSize ){
         int nWrite = seekAndWrite(pFile, iWrite, "", 1);
         if( nWrite!=1 ) return SQLITE_IOERR_WRITE;
@@ -3728,6 +4026,16 @@ static void unixModeBit(unixFile *pFile, unsigned char mask, int *pArg){
 /* Forward declaration */
 static int unixGetTempname(int nBuf, char *zBuf);
 
+/*
+** Connections waiting for a shared-memory lock are woken using a futex
+** on Linux. See unixShmWait().
+*/
+#if defined(__linux__) && defined(__GNUC__) && !defined(SQLITE_OMIT_WAL) \
+ && !defined(SQLITE_DISABLE_SHM_WAKE)
+# define UNIX_SHM_WAKE_ENABLED 1
+static int unixShmWait(unixFile*, int);
+#endif
+
 /*
 ** Information and control of an open file handle.
 */
@@ -3779,12 +4087,54 @@ static int unixFileControl(sqlite3_file *id, int op, void *pArg){
         newLimit = sqlite3GlobalConfig.mxMmap;
       }
       *(i64*)pArg = pFile->mmapSizeMax;
+#ifdef UNIX_DIRECT_IO_ENABLED
+      if( pFile->ctrlFlags & UNIXFILE_DIRECT ) newLimit = 0;
+#endif
       if( newLimit>=0 ){
         pFile->mmapSizeMax = newLimit;
         if( newLimit<pFile->mmapSize ) pFile->mmapSize = newLimit;
       }
       return SQLITE_OK;
     }
+    case SQLITE_FCNTL_READAHEAD: {
+#if defined(HAVE_POSIX_FADVISE) && HAVE_POSIX_FADVISE \
+      && defined(POSIX_FADV_WILLNEED)
+      i64 *aRange = (i64*)pArg;
+      posix_fadvise(pFile->h, aRange[0], aRange[1], POSIX_FADV_WILLNEED);
+#endif
+      return SQLITE_OK;
+    }
+    case SQLITE_FCNTL_WRITEBACK: {
+#if defined(HAVE_SYNC_FILE_RANGE) && HAVE_SYNC_FILE_RANGE \
+      && defined(SYNC_FILE_RANGE_WRITE)
+      i64 *aRange = (i64*)pArg;
+      sync_file_range(pFile->h, aRange[0], aRange[1], SYNC_FILE_RANGE_WRITE);
+#endif
+      return SQLITE_OK;
+    }
+    case SQLITE_FCNTL_BUFFER_ALIGN: {
+      int szAlign = 0;
+#ifdef UNIX_DIRECT_IO_ENABLED
+      if( pFile->ctrlFlags & UNIXFILE_DIRECT ) szAlign = UNIX_DIRECT_ALIGN;
+#endif
+      *(int*)pArg = szAlign;
+      return SQLITE_OK;
+    }
+#if HAVE_PWRITEV
+    case SQLITE_FCNTL_PARALLEL_WRITE: {
+      /* Concurrent calls to unixWritev() are safe, except on a file open
+      ** for direct I/O, as unaligned writes share the aDirect[] buffer. */
+      if( pArg!=(void*)id || (pFile->ctrlFlags & UNIXFILE_DIRECT) ){
+        return SQLITE_NOTFOUND;
+      }
+      return SQLITE_OK;
+    }
+#endif
+#ifdef UNIX_SHM_WAKE_ENABLED
+    case SQLITE_FCNTL_BUSY_WAIT: {
+      return unixShmWait(pFile, *(int*)pArg);
+    }
+#endif
 #ifdef SQLITE_DEBUG
     /* The pager calls this method to signal that it has done
     ** a rollback and that the database is therefore unchanged and
@@ -3972,6 +4322,7 @@ struct unixShmNode {
   char **apRegion;           /* Array of mapped shared-memory regions */
   int nRef;                  /* Number of unixShm objects pointing to this */
   unixShm *pFirst;           /* All unixShm objects pointing to this */
+  int aLock[SQLITE_SHM_NLOCK];  /* Shared lock count, or -1 for exclusive */
 #ifdef SQLITE_DEBUG
   u8 exclMask;               /* Mask of exclusive locks held */
   u8 sharedMask;             /* Mask of shared locks held */
@@ -3990,7 +4341,8 @@ struct unixShmNode {
 **    unixShm.id
 **
 ** All other fields are read/write.  The unixShm.pFile->mutex must be held
-** while accessing any read/write fields.
+** while accessing any read/write fields, except that the sharedMask and
+** exclMask fields are only ever accessed by the connection that owns them.
 */
 struct unixShm {
   unixShmNode *pShmNode;     /* The underlying unixShmNode object */
@@ -3999,6 +4351,8 @@ struct unixShm {
   u8 id;                     /* Id of this connection within its unixShmNode */
   u16 sharedMask;            /* Mask of shared locks held */
   u16 exclMask;              /* Mask of exclusive locks held */
+  u8 bWakeSeq;               /* True if the last lock attempt failed */
+  u32 iWakeSeq;              /* Wake-up counter before that attempt */
 };
 
 /*
@@ -4006,6 +4360,118 @@ struct unixShm {
 */
 #define UNIX_SHM_BASE   ((22+SQLITE_SHM_NLOCK)*4)         /* first lock byte */
 #define UNIX_SHM_DMS    (UNIX_SHM_BASE+SQLITE_SHM_NLOCK)  /* deadman switch */
+#define UNIX_SHM_WAKE   (UNIX_SHM_BASE+12)                /* wake-up counter */
+
+/*
+** Element i of the unixShmNode.aLock[] array is the number of connections
+** in this process that hold a shared lock on shared-memory lock i, or -1
+** if a connection in this process holds an exclusive lock on it. The
+** system-level (fcntl) lock is only taken when the first connection in 
+** the process obtains a lock and released when the last one releases it.
+**
+** Where the compiler provides an atomic compare-and-swap, a shared lock
+** that is already held by another connection in this process is taken
+** or released by adjusting the count without entering the unixShmNode 
+** mutex. So readers do not make system calls or contend for the mutex
+** unless they are the first or last reader in the process to use a
+** particular read-mark.
+*/
+#if defined(__GNUC__) && !defined(SQLITE_DISABLE_SHM_ATOMIC)
+# define UNIX_SHM_ATOMIC_ENABLED 1
+# define unixShmCas(p,a,b) __sync_bool_compare_and_swap(p,a,b)
+#else
+# define unixShmCas(p,a,b) (*(p)==(a) ? (*(p)=(b), 1) : 0)
+#endif
+
+/*
+** If *pLock is greater than iMin, add iDelta to it and return true.
+** Otherwise, leave it unchanged and return false.
+*/
+static int unixShmLockAdjust(int *pLock, int iMin, int iDelta){
+  int n;
+  while( (n = *(volatile int*)pLock)>iMin ){
+    if( unixShmCas(pLock, n, n+iDelta) ) return 1;
+  }
+  return 0;
+}
+
+/*
+** On Linux, the 32-bit word at offset UNIX_SHM_WAKE of the first 
+** shared-memory region is a counter that is incremented each time an
+** exclusive lock is released. It lies in a part of the wal-index header
+** that is reserved but never locked. A connection that fails to obtain a
+** lock remembers the value the counter held beforehand. If the 
+** busy-handler then invokes SQLITE_FCNTL_BUSY_WAIT, the connection waits
+** on a futex for the counter to change, instead of sleeping for a fixed
+** interval. Shared locks, such as the read lock released by the waiting
+** connection itself just before the busy-handler runs, do not wake
+** waiters.
+**
+** The least significant bit of the counter is set while there may be 
+** connections waiting, so that a connection releasing a lock only makes
+** the FUTEX_WAKE system call when it is required.
+*/
+#ifdef UNIX_SHM_WAKE_ENABLED
+# include <sys/syscall.h>
+# include <linux/futex.h>
+
+/*
+** Return a pointer to the wake-up counter, or NULL if it is not available.
+** The caller must hold the unixShmNode mutex.
+*/
+static volatile u32 *unixShmWakeWord(unixShmNode *pShmNode){
+  if( pShmNode->nRegion==0 || pShmNode->isReadonly ) return 0;
+  return (volatile u32*)&pShmNode->apRegion[0][UNIX_SHM_WAKE];
+}
+
+/*
+** Increment the wake-up counter and, if there may be connections waiting
+** on it, wake them.
+*/
+static void unixShmWake(volatile u32 *pWake){
+  u32 iOld;
+  do{
+    iOld = *pWake;
+  }while( !__sync_bool_compare_and_swap(pWake, iOld, (iOld+2) & ~(u32)1) );
+  if( iOld & 1 ){
+    syscall(SYS_futex, pWake, FUTEX_WAKE, 0x7fffffff, 0, 0, 0);
+  }
+}
+
+/*
+** Implementation of SQLITE_FCNTL_BUSY_WAIT. Wait for up to nUs 
+** microseconds for the wake-up counter to change from the value it held
+** before the last failed lock attempt. Return SQLITE_NOTFOUND if the 
+** last lock attempt did not fail.
+*/
+static int unixShmWait(unixFile *pDbFd, int nUs){
+  unixShm *p = pDbFd->pShm;
+  volatile u32 *pWake;
+  u32 iSeq;
+  struct timespec ts;
+
+  if( p==0 || p->bWakeSeq==0 ) return SQLITE_NOTFOUND;
+  sqlite3_mutex_enter(p->pShmNode->mutex);
+  pWake = unixShmWakeWord(p->pShmNode);
+  sqlite3_mutex_leave(p->pShmNode->mutex);
+  if( pWake==0 ) return SQLITE_NOTFOUND;
+  iSeq = p->iWakeSeq & ~(u32)1;
+  p->bWakeSeq = 0;
+
+  /* Set the "waiting" flag, unless the counter has changed already */
+  while( 1 ){
+    u32 iCur = *pWake;
+    if( (iCur & ~(u32)1)!=iSeq ) return SQLITE_OK;
+    if( (iCur & 1) || __sync_bool_compare_and_swap(pWake, iSeq, iSeq|1) ){
+      break;
+    }
+  }
+  ts.tv_sec = nUs / 1000000;
+  ts.tv_nsec = (nUs % 1000000) * 1000;
+  syscall(SYS_futex, pWake, FUTEX_WAIT, iSeq|1, &ts, 0, 0);
+  return SQLITE_OK;
+}
+#endif /* UNIX_SHM_WAKE_ENABLED */
 
 /*
 ** Apply posix advisory locks for all bytes from ofst through ofst+n-1.
@@ -4426,10 +4892,15 @@ static int unixShmLock(
 ){
   unixFile *pDbFd = (unixFile*)fd;      /* Connection holding shared memory */
   unixShm *p = pDbFd->pShm;             /* The shared memory being locked */
-  unixShm *pX;                          /* For looping over all siblings */
   unixShmNode *pShmNode = p->pShmNode;  /* The underlying file iNode */
   int rc = SQLITE_OK;                   /* Result code */
   u16 mask;                             /* Mask of locks to take or release */
+  int i;                                /* Iterator for pShmNode->aLock[] */
+#ifdef UNIX_SHM_WAKE_ENABLED
+  volatile u32 *pWake;                  /* Wake-up counter, if any */
+  u32 iSeq = 0;                         /* Value of *pWake before locking */
+  int bWake = 0;                        /* True to increment *pWake */
+#endif
 
   assert( pShmNode==pDbFd->pInode->pShmNode );
   assert( pShmNode->pInode==pDbFd->pInode );
@@ -4445,63 +4916,93 @@ static int unixShmLock(
 
   mask = (1<<(ofst+n)) - (1<<ofst);
   assert( n>1 || mask==(1<<ofst) );
-  sqlite3_mutex_enter(pShmNode->mutex);
+
+  /* A connection never takes a lock it already holds. Nor does it release
+  ** a lock it does not hold, but ignore such requests if it does. */
   if( flags & SQLITE_SHM_UNLOCK ){
-    u16 allMask = 0; /* Mask of locks held by siblings */
+    if( ((p->exclMask|p->sharedMask) & mask)==0 ) return SQLITE_OK;
+  }else{
+    assert( ((p->exclMask|p->sharedMask) & mask)==0 );
+  }
 
-    /* See if any siblings hold this same lock */
-    for(pX=pShmNode->pFirst; pX; pX=pX->pNext){
-      if( pX==p ) continue;
-      assert( (pX->exclMask & (p->exclMask|p->sharedMask))==0 );
-      allMask |= pX->sharedMask;
+#ifdef UNIX_SHM_ATOMIC_ENABLED
+  /* If another connection in this process holds the same shared lock,
+  ** take or release it without entering the mutex.  */
+  if( flags==(SQLITE_SHM_LOCK | SQLITE_SHM_SHARED) ){
+    if( unixShmLockAdjust(&pShmNode->aLock[ofst], 0, 1) ){
+      p->sharedMask |= mask;
+#ifdef UNIX_SHM_WAKE_ENABLED
+      p->bWakeSeq = 0;
+#endif
+      return SQLITE_OK;
+    }
+  }else if( (flags & SQLITE_SHM_UNLOCK)!=0 && (p->sharedMask & mask)!=0 ){
+    if( unixShmLockAdjust(&pShmNode->aLock[ofst], 1, -1) ){
+      p->sharedMask &= ~mask;
+      return SQLITE_OK;
     }
+  }
+#endif
 
-    /* Unlock the system-level locks */
-    if( (mask & allMask)==0 ){
+  sqlite3_mutex_enter(pShmNode->mutex);
+#ifdef UNIX_SHM_WAKE_ENABLED
+  pWake = unixShmWakeWord(pShmNode);
+  if( pWake ) iSeq = *pWake;
+  if( (flags & SQLITE_SHM_UNLOCK)==0 ) p->bWakeSeq = 0;
+#endif
+  if( flags & SQLITE_SHM_UNLOCK ){
+    if( p->exclMask & mask ){
+      assert( (p->exclMask & mask)==mask );
       rc = unixShmSystemLock(pShmNode, F_UNLCK, ofst+UNIX_SHM_BASE, n);
+      if( rc==SQLITE_OK ){
+        for(i=ofst; i<ofst+n; i++){
+          assert( pShmNode->aLock[i]==-1 );
+          pShmNode->aLock[i] = 0;
+        }
+        p->exclMask &= ~mask;
+#ifdef UNIX_SHM_WAKE_ENABLED
+        bWake = (pWake!=0);
+#endif
+      }
     }else{
-      rc = SQLITE_OK;
-    }
-
-    /* Undo the local locks */
-    if( rc==SQLITE_OK ){
-      p->exclMask &= ~mask;
-      p->sharedMask &= ~mask;
-    } 
-  }else if( flags & SQLITE_SHM_SHARED ){
-    u16 allShared = 0;  /* Union of locks held by connections other than "p" */
-
-    /* Find out which shared locks are already held by sibling connections.
-    ** If any sibling already holds an exclusive lock, go ahead and return
-    ** SQLITE_BUSY.
-    */
-    for(pX=pShmNode->pFirst; pX; pX=pX->pNext){
-      if( (pX->exclMask & mask)!=0 ){
-        rc = SQLITE_BUSY;
-        break;
+      /* Release a shared lock. If this is the last connection in the
+      ** process to hold it, release the system-level lock as well. The
+      ** count may be incremented by another connection that does not hold
+      ** the mutex at any point until it is set to zero.  */
+      int *pLock = &pShmNode->aLock[ofst];
+      assert( n==1 );
+      while( !unixShmLockAdjust(pLock, 1, -1) ){
+        if( unixShmCas(pLock, 1, 0) ){
+          rc = unixShmSystemLock(pShmNode, F_UNLCK, ofst+UNIX_SHM_BASE, 1);
+          if( rc!=SQLITE_OK ) *pLock = 1;
+          break;
+        }
       }
-      allShared |= pX->sharedMask;
-    }
-
-    /* Get shared locks at the system level, if necessary */
-    if( rc==SQLITE_OK ){
-      if( (allShared & mask)==0 ){
-        rc = unixShmSystemLock(pShmNode, F_RDLCK, ofst+UNIX_SHM_BASE, n);
-      }else{
-        rc = SQLITE_OK;
+      if( rc==SQLITE_OK ){
+        p->sharedMask &= ~mask;
       }
     }
-
-    /* Get the local shared locks */
+  }else if( flags & SQLITE_SHM_SHARED ){
+    /* If a connection in this process holds an exclusive lock, return
+    ** SQLITE_BUSY right away. If another holds a shared lock, increment
+    ** the count. Otherwise obtain the system-level lock. While the mutex
+    ** is held, the count may not change from zero.  */
+    int *pLock = &pShmNode->aLock[ofst];
+    if( *pLock<0 ){
+      rc = SQLITE_BUSY;
+    }else if( !unixShmLockAdjust(pLock, 0, 1) ){
+      rc = unixShmSystemLock(pShmNode, F_RDLCK, ofst+UNIX_SHM_BASE, 1);
+      if( rc==SQLITE_OK ) *pLock = 1;
+    }
     if( rc==SQLITE_OK ){
       p->sharedMask |= mask;
     }
   }else{
-    /* Make sure no sibling connections hold locks that will block this
-    ** lock.  If any do, return SQLITE_BUSY right away.
+    /* Make sure no connection in this process holds locks that will block
+    ** this lock.  If any do, return SQLITE_BUSY right away.
     */
-    for(pX=pShmNode->pFirst; pX; pX=pX->pNext){
-      if( (pX->exclMask & mask)!=0 || (pX->sharedMask & mask)!=0 ){
+    for(i=ofst; i<ofst+n; i++){
+      if( pShmNode->aLock[i]!=0 ){
         rc = SQLITE_BUSY;
         break;
       }
@@ -4513,12 +5014,21 @@ static int unixShmLock(
     if( rc==SQLITE_OK ){
       rc = unixShmSystemLock(pShmNode, F_WRLCK, ofst+UNIX_SHM_BASE, n);
       if( rc==SQLITE_OK ){
-        assert( (p->sharedMask & mask)==0 );
+        for(i=ofst; i<ofst+n; i++) pShmNode->aLock[i] = -1;
         p->exclMask |= mask;
       }
     }
   }
+#ifdef UNIX_SHM_WAKE_ENABLED
+  if( rc==SQLITE_BUSY && pWake ){
+    p->bWakeSeq = 1;
+    p->iWakeSeq = iSeq;
+  }
+#endif
   sqlite3_mutex_leave(pShmNode->mutex);
+#ifdef UNIX_SHM_WAKE_ENABLED
+  if( bWake && rc==SQLITE_OK ) unixShmWake(pWake);
+#endif
   OSTRACE(("SHM-LOCK shmid-%d, pid-%d got %03x,%03x\n",
            p->id, getpid(), p->sharedMask, p->exclMask));
   return rc;
@@ -4553,6 +5063,7 @@ static int unixShmUnmap(
   unixShmNode *pShmNode;          /* The underlying shared-memory file */
   unixShm **pp;                   /* For looping over sibling connections */
   unixFile *pDbFd;                /* The underlying database file */
+  int i;                          /* Iterator for pShmNode->aLock[] */
 
   pDbFd = (unixFile*)fd;
   p = pDbFd->pShm;
@@ -4568,6 +5079,17 @@ static int unixShmUnmap(
   for(pp=&pShmNode->pFirst; (*pp)!=p; pp = &(*pp)->pNext){}
   *pp = p->pNext;
 
+  /* Drop any locks still held by p from the counts of locks held by
+  ** connections in this process.  */
+  for(i=0; i<SQLITE_SHM_NLOCK; i++){
+    int *pLock = &pShmNode->aLock[i];
+    if( p->exclMask & (1<<i) ){
+      *pLock = 0;
+    }else if( p->sharedMask & (1<<i) ){
+      while( !unixShmLockAdjust(pLock, 1, -1) && !unixShmCas(pLock, 1, 0) );
+    }
+  }
+
   /* Free the connection p */
   sqlite3_free(p);
   pDbFd->pShm = 0;
@@ -4697,6 +5219,15 @@ static void unixRemapfile(
     pNew = osMmap(0, nNew, flags, MAP_SHARED, h, 0);
   }
 
+#if defined(SQLITE_ENABLE_HUGEPAGE) && defined(MADV_HUGEPAGE)
+  /* Allow the kernel to map the file using huge pages, if the file-system
+  ** supports this. Large memory-mapped databases otherwise use a great
+  ** many TLB entries. */
+  if( pNew!=MAP_FAILED ){
+    madvise(pNew, nNew, MADV_HUGEPAGE);
+  }
+#endif
+
   if( pNew==MAP_FAILED ){
     pNew = 0;
     nNew = 0;
@@ -4831,6 +5362,78 @@ static int unixUnfetch(sqlite3_file *fd, i64 iOff, void *p){
 ********************** End sqlite3_file Methods *******************************
 ******************************************************************************/
 
+#ifdef SQLITE_ENABLE_HUGEPAGE
+/*
+** The size of a huge page. Buffers allocated by sqlite3OsHugeAlloc() are
+** rounded up to a multiple of this.
+*/
+#ifndef SQLITE_HUGEPAGE_SIZE
+# define SQLITE_HUGEPAGE_SIZE (2*1024*1024)
+#endif
+
+#if defined(__linux__) && !defined(SQLITE_DISABLE_NUMA)
+# include <sys/syscall.h>
+# if defined(SYS_mbind)
+#  define UNIX_NUMA_INTERLEAVE 1
+#  define UNIX_MPOL_INTERLEAVE 3  /* MPOL_INTERLEAVE from <linux/mempolicy.h> */
+# endif
+#endif
+
+/*
+** Round nByte up to a multiple of the huge page size.
+*/
+static size_t unixHugeRound(sqlite3_int64 nByte){
+  const sqlite3_int64 sz = SQLITE_HUGEPAGE_SIZE;
+  return (size_t)((nByte + sz - 1) / sz * sz);
+}
+
+/*
+** Allocate a buffer of at least nByte bytes directly from the operating
+** system, for use as the page-cache arena. Return NULL if the allocation
+** fails.
+**
+** The buffer is backed by huge pages if possible. It is first requested
+** with MAP_HUGETLB, which only succeeds if the administrator has reserved
+** huge pages. Otherwise an ordinary anonymous mapping is created and
+** marked with MADV_HUGEPAGE so that transparent huge pages may be used.
+**
+** On Linux, the buffer is also interleaved across all NUMA nodes the
+** process may use, so that page-cache accesses from threads running on
+** any node see the same average latency. This is done before the buffer
+** is touched, as the policy only applies to pages not yet faulted in.
+** Errors are ignored, as the buffer is usable either way.
+*/
+void *sqlite3OsHugeAlloc(sqlite3_int64 nByte){
+  size_t n = unixHugeRound(nByte);
+  void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  p = osMmap(0, n, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,
+             -1, 0);
+#endif
+  if( p==MAP_FAILED ){
+    p = osMmap(0, n, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if( p==MAP_FAILED ) return 0;
+#ifdef MADV_HUGEPAGE
+    madvise(p, n, MADV_HUGEPAGE);
+#endif
+  }
+#ifdef UNIX_NUMA_INTERLEAVE
+  {
+    unsigned long mask = ~(unsigned long)0;
+    syscall(SYS_mbind, p, n, UNIX_MPOL_INTERLEAVE, &mask, sizeof(mask)*8, 0);
+  }
+#endif
+  return p;
+}
+
+/*
+** Free a buffer obtained from sqlite3OsHugeAlloc(nByte).
+*/
+void sqlite3OsHugeFree(void *p, sqlite3_int64 nByte){
+  if( p ) osMunmap(p, unixHugeRound(nByte));
+}
+#endif /* SQLITE_ENABLE_HUGEPAGE */
+
 /*
 ** This division contains definitions of sqlite3_io_methods objects that
 ** implement various file locking strategies.  It also contains definitions
@@ -4886,6 +5489,7 @@ static const sqlite3_io_methods METHOD = {                                   \
    unixShmUnmap,               /* xShmUnmap */                               \
    unixFetch,                  /* xFetch */                                  \
    unixUnfetch,                /* xUnfetch */                                \
+   unixWritev,                 /* xWritev */                                 \
 };                                                                           \
 static const sqlite3_io_methods *FINDER##Impl(const char *z, unixFile *p){   \
   UNUSED_PARAMETER(z); UNUSED_PARAMETER(p);                                  \
@@ -4902,7 +5506,7 @@ static const sqlite3_io_methods *(*const FINDER)(const char*,unixFile *p)    \
 IOMETHODS(
   posixIoFinder,            /* Finder function name */
   posixIoMethods,           /* sqlite3_io_methods object name */
-  3,                        /* shared memory and mmap are enabled */
+  4,                        /* shared memory, mmap and writev are enabled */
   unixClose,                /* xClose method */
   unixLock,                 /* xLock method */
   unixUnlock,               /* xUnlock method */
@@ -5776,6 +6380,13 @@ static int unixOpen(
 #endif
   
   rc = fillInUnixFile(pVfs, fd, pFile, zPath, ctrlFlags);
+#ifdef UNIX_DIRECT_IO_ENABLED
+  if( rc==SQLITE_OK && eType==SQLITE_OPEN_MAIN_DB && unixDirectOpen(fd,zPath) ){
+    /* The OS cache is bypassed, so memory-mapping is not used either */
+    p->ctrlFlags |= UNIXFILE_DIRECT;
+    p->mmapSizeMax = 0;
+  }
+#endif
 
 open_finished:
   if( rc!=SQLITE_OK ){
@@ -7391,7 +8002,7 @@ int sqlite3_os_init(void){
 
   /* Double-check that the aSyscall[] array has been constructed
   ** correctly.  See ticket [bb3a86e890c8e96ab] */
-  assert( ArraySize(aSyscall)==24 );
+  assert( ArraySize(aSyscall)==25 );
 
   /* Register all VFSes defined in the aVfs[] array */
   for(i=0; i<(sizeof(aVfs)/sizeof(sqlite3_vfs)); i++){
@@ -3833,7 +3833,8 @@ static const sqlite3_io_methods winIoMethod = {
   winShmBarrier,                  /* xShmBarrier */
   winShmUnmap,                    /* xShmUnmap */
   winFetch,                       /* xFetch */
-  winUnfetch                      /* xUnfetch */
+  winUnfetch,                     /* xUnfetch */
+  0                               /* xWritev */
 };
 
 /****************************************************************************
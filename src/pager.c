@@ -614,6 +614,7 @@ struct Pager {
   u8 useJournal;              /* Use a rollback journal on this file */
   u8 noSync;                  /* Do not sync the journal if true */
   u8 fullSync;                /* Do extra syncs of the journal for robustness */
+  u8 journalPipeline;         /* True for pipelined PERSIST/TRUNCATE commits */
   u8 ckptSyncFlags;           /* SYNC_NORMAL or SYNC_FULL for checkpoint */
   u8 walSyncFlags;            /* SYNC_NORMAL or SYNC_FULL for wal writes */
   u8 syncFlags;               /* SYNC_NORMAL or SYNC_FULL otherwise */
@@ -637,6 +638,7 @@ struct Pager {
   u8 doNotSpill;              /* Do not spill the cache when non-zero */
   u8 doNotSyncSpill;          /* Do not do a spill that requires jrnl sync */
   u8 subjInMemory;            /* True to use in-memory sub-journals */
+  u8 pipelineHdr;             /* Current j-header written with nRec==-1 */
   Pgno dbSize;                /* Number of pages in the database */
   Pgno dbOrigSize;            /* dbSize before the current transaction */
   Pgno dbFileSize;            /* Number of pages in the database file */
@@ -645,7 +647,10 @@ struct Pager {
   int nRec;                   /* Pages journalled since last j-header written */
   u32 cksumInit;              /* Quasi-random value added to every checksum */
   u32 nSubRec;                /* Number of records written to sub-journal */
+  u32 iDataVersion;           /* Changes whenever the page cache is reset */
   Bitvec *pInJournal;         /* One bit for each page in the database file */
+  Bitvec *pAllRead;           /* Pages used by a concurrent transaction */
+  u8 *aPage1Base;             /* Page 1 when a concurrent transaction began */
   sqlite3_file *fd;           /* File descriptor for database */
   sqlite3_file *jfd;          /* File descriptor for main journal */
   sqlite3_file *sjfd;         /* File descriptor for sub-journal */
@@ -675,7 +680,15 @@ struct Pager {
   char *zJournal;             /* Name of the journal file */
   int (*xBusyHandler)(void*); /* Function to call when busy */
   void *pBusyHandlerArg;      /* Context argument for xBusyHandler */
-  int aStat[3];               /* Total cache hits, misses and writes */
+  int aStat[5];               /* Cache hits, misses, writes, read-ahead */
+  int nReadahead;             /* Maximum read-ahead window, in pages */
+  int nCkptThread;            /* Worker threads used by checkpoints */
+  int nRaWindow;              /* Current read-ahead window, in pages */
+  int nRaRun;                 /* Length of current run of sequential reads */
+  u8 bRaStray;                /* Last read was not part of the run */
+  Pgno iRaLast;               /* Last page read from the database file */
+  Pgno iRaStart;              /* First page requested by this run */
+  Pgno iRaEnd;                /* One more than the last page requested */
 #ifdef SQLITE_TEST
   int nRead;                  /* Database pages read */
 #endif
@@ -696,12 +709,24 @@ struct Pager {
 
 /*
 ** Indexes for use with Pager.aStat[]. The Pager.aStat[] array contains
-** the values accessed by passing SQLITE_DBSTATUS_CACHE_HIT, CACHE_MISS 
-** or CACHE_WRITE to sqlite3_db_status().
+** the values accessed by passing SQLITE_DBSTATUS_CACHE_HIT, CACHE_MISS,
+** CACHE_WRITE, READAHEAD_HIT or READAHEAD_WASTE to sqlite3_db_status().
 */
-#define PAGER_STAT_HIT   0
-#define PAGER_STAT_MISS  1
-#define PAGER_STAT_WRITE 2
+#define PAGER_STAT_HIT      0
+#define PAGER_STAT_MISS     1
+#define PAGER_STAT_WRITE    2
+#define PAGER_STAT_RA_HIT   3
+#define PAGER_STAT_RA_WASTE 4
+
+/*
+** Read-ahead begins once PAGER_READAHEAD_RUN consecutive pages have been
+** read from the database file. The first request is for
+** PAGER_READAHEAD_MIN pages. Each subsequent request made during the 
+** same run of sequential reads is for twice as many pages as the 
+** previous one, up to a limit of Pager.nReadahead pages.
+*/
+#define PAGER_READAHEAD_RUN 4
+#define PAGER_READAHEAD_MIN 4
 
 /*
 ** The following global variables hold counters used for
@@ -813,6 +838,7 @@ static int pagerUseWal(Pager *pPager){
 # define pagerWalFrames(v,w,x,y) 0
 # define pagerOpenWalIfPresent(z) SQLITE_OK
 # define pagerBeginReadTransaction(z) SQLITE_OK
+# define pagerLockForCommit(z) SQLITE_OK
 #endif
 
 #ifndef NDEBUG 
@@ -1403,10 +1429,24 @@ static int writeJournalHdr(Pager *pPager){
   **
   **   * When the SQLITE_IOCAP_SAFE_APPEND flag is set. This guarantees
   **     that garbage data is never appended to the journal file.
+  **
+  ** 0xFFFFFFFF is also written if "PRAGMA journal_pipeline" is enabled
+  ** and the journal mode is PERSIST or TRUNCATE. In this case the
+  ** checksum on each page record is relied upon to detect garbage data
+  ** at the end of the journal, and when the transaction is committed
+  ** syncJournal() saves a sync and a write by not updating the header.
+  ** Pager.pipelineHdr is set to tell it so. This is only done for the
+  ** first header in the journal, as pager_playback() does not expect
+  ** 0xFFFFFFFF in any other.
   */
   assert( isOpen(pPager->fd) || pPager->noSync );
+  pPager->pipelineHdr = (pPager->journalPipeline && pPager->journalHdr==0
+   && (pPager->journalMode==PAGER_JOURNALMODE_PERSIST
+    || pPager->journalMode==PAGER_JOURNALMODE_TRUNCATE)
+  );
   if( pPager->noSync || (pPager->journalMode==PAGER_JOURNALMODE_MEMORY)
    || (sqlite3OsDeviceCharacteristics(pPager->fd)&SQLITE_IOCAP_SAFE_APPEND) 
+   || pPager->pipelineHdr
   ){
     memcpy(zHeader, aJournalMagic, sizeof(aJournalMagic));
     put32bits(&zHeader[sizeof(aJournalMagic)], 0xffffffff);
@@ -1686,6 +1726,7 @@ static PgHdr *pager_lookup(Pager *pPager, Pgno pgno){
 ** Discard the entire contents of the in-memory page-cache.
 */
 static void pager_reset(Pager *pPager){
+  pPager->iDataVersion++;
   sqlite3BackupRestart(pPager->pBackup);
   sqlite3PcacheClear(pPager->pPCache);
 }
@@ -1709,6 +1750,17 @@ static void releaseAllSavepoints(Pager *pPager){
   pPager->nSubRec = 0;
 }
 
+/*
+** Free the structures used to track a concurrent transaction (see
+** sqlite3PagerBeginConcurrent()), if any.
+*/
+static void pagerEndConcurrent(Pager *pPager){
+  sqlite3BitvecDestroy(pPager->pAllRead);
+  pPager->pAllRead = 0;
+  sqlite3_free(pPager->aPage1Base);
+  pPager->aPage1Base = 0;
+}
+
 /*
 ** Set the bit number pgno in the PagerSavepoint.pInSavepoint 
 ** bitvecs of all open savepoints. Return SQLITE_OK if successful
@@ -1755,6 +1807,7 @@ static void pager_unlock(Pager *pPager){
 
   sqlite3BitvecDestroy(pPager->pInJournal);
   pPager->pInJournal = 0;
+  pagerEndConcurrent(pPager);
   releaseAllSavepoints(pPager);
 
   if( pagerUseWal(pPager) ){
@@ -2011,6 +2064,7 @@ static int pager_end_transaction(Pager *pPager, int hasMaster, int bCommit){
     rc2 = pagerUnlockDb(pPager, SHARED_LOCK);
     pPager->changeCountDone = 0;
   }
+  pagerEndConcurrent(pPager);
   pPager->eState = PAGER_READER;
   pPager->setMaster = 0;
 
@@ -2845,6 +2899,69 @@ end_playback:
 }
 
 
+/*
+** This function is called before page pgno is read from the database
+** file. It detects runs of sequential reads and, when one is found,
+** uses the SQLITE_FCNTL_READAHEAD file-control to tell the VFS which
+** pages are likely to be read next. A read of a page that is greater
+** than the last page read and no greater than the last page requested
+** in advance does not end the run, as the pages skipped over may be
+** in the cache already.
+**
+** Pages requested in advance that have not been read by the time the
+** run ends are counted as wasted.
+*/
+static void pagerReadahead(Pager *pPager, Pgno pgno){
+  if( pgno>pPager->iRaLast
+   && (pgno==pPager->iRaLast+1 || pgno<pPager->iRaEnd)
+  ){
+    if( pgno>=pPager->iRaStart && pgno<pPager->iRaEnd ){
+      pPager->aStat[PAGER_STAT_RA_HIT]++;
+    }
+    pPager->nRaRun++;
+    pPager->bRaStray = 0;
+  }else if( pPager->nRaRun>=PAGER_READAHEAD_RUN && pPager->bRaStray==0 ){
+    /* A single out-of-sequence read, for example of an interior b-tree 
+    ** page as a scan moves from one subtree to the next, does not end
+    ** the run. */
+    pPager->bRaStray = 1;
+    return;
+  }else{
+    if( pPager->iRaEnd>pPager->iRaLast+1 ){
+      pPager->aStat[PAGER_STAT_RA_WASTE] += 
+          pPager->iRaEnd - pPager->iRaLast - 1;
+    }
+    pPager->nRaRun = 1;
+    pPager->nRaWindow = 0;
+    pPager->iRaStart = pPager->iRaEnd = 0;
+    pPager->bRaStray = 0;
+  }
+  pPager->iRaLast = pgno;
+
+  /* Once less than half of the last window remains to be read, request
+  ** the next one. */
+  if( pPager->nRaRun>=PAGER_READAHEAD_RUN
+   && pgno+pPager->nRaWindow/2>=pPager->iRaEnd
+  ){
+    Pgno iFirst = (pPager->iRaEnd>pgno ? pPager->iRaEnd : pgno+1);
+    Pgno iEnd;
+    int nWindow = pPager->nRaWindow*2;
+    if( nWindow<PAGER_READAHEAD_MIN ) nWindow = PAGER_READAHEAD_MIN;
+    if( nWindow>pPager->nReadahead ) nWindow = pPager->nReadahead;
+    pPager->nRaWindow = nWindow;
+    iEnd = pgno + 1 + nWindow;
+    if( iEnd>pPager->dbSize+1 ) iEnd = pPager->dbSize+1;
+    if( iFirst<iEnd ){
+      i64 aRange[2];
+      aRange[0] = (iFirst-1)*(i64)pPager->pageSize;
+      aRange[1] = (iEnd-iFirst)*(i64)pPager->pageSize;
+      sqlite3OsFileControlHint(pPager->fd, SQLITE_FCNTL_READAHEAD, aRange);
+      if( pPager->iRaEnd==0 ) pPager->iRaStart = iFirst;
+      pPager->iRaEnd = iEnd;
+    }
+  }
+}
+
 /*
 ** Read the content for page pPg out of the database file and into 
 ** pPg->pData. A shared lock or greater must be held on the database
@@ -2879,6 +2996,7 @@ static int readDbPage(PgHdr *pPg, u32 iFrame){
 #endif
   {
     i64 iOffset = (pgno-1)*(i64)pPager->pageSize;
+    if( pPager->nReadahead>0 ) pagerReadahead(pPager, pgno);
     rc = sqlite3OsRead(pPager->fd, pPg->pData, pgsz, iOffset);
     if( rc==SQLITE_IOERR_SHORT_READ ){
       rc = SQLITE_OK;
@@ -2987,6 +3105,117 @@ static int pagerUndoCallback(void *pCtx, Pgno iPg){
   return rc;
 }
 
+/*
+** This function is called by pagerConcurrentUndo() when page 1 has been
+** written by transactions committed since a concurrent transaction began.
+** The snapshot has already been moved forward to include them.
+**
+** The change counter (bytes 24..27) and version fields (bytes 92..99) of
+** page 1 are written by every commit, so the committed values are simply
+** copied into the cached page 1. They are updated again when this
+** transaction commits. The database size (bytes 28..31) and freelist
+** (bytes 32..39) fields change whenever the file grows or a page is
+** allocated or freed, so they are not treated as a conflict either. If
+** one of these was changed by the other transactions but not by this one,
+** their value is copied into the cached page 1. If it was changed by
+** both, SQLITE_BUSY_SNAPSHOT is returned. Both transactions would then
+** have used the same freelist pages, or the same pages at the end of the
+** file, so this is usually also a conflict at the page level. A change to
+** any other part of page 1, such as the schema cookie or the sqlite_master
+** table, is a conflict.
+*/
+static int pagerMergePage1(Pager *pPager){
+  static const struct MergeField {
+    int iOff;                     /* Offset of field within page 1 */
+    int nByte;                    /* Size of field in bytes */
+  } aField[] = {
+    { 28, 4 },                    /* Database size in pages */
+    { 32, 8 },                    /* Freelist trunk page and count */
+  }, aCommit[] = {
+    { 24, 4 },                    /* File change counter */
+    { 92, 8 },                    /* Version-valid-for and version number */
+  };
+  int pgsz = pPager->pageSize;    /* Page size in bytes */
+  u8 *aBase = pPager->aPage1Base; /* Page 1 when the transaction began */
+  u8 *aNew = (u8*)pPager->pTmpSpace;  /* Page 1 committed by others */
+  u8 *aOurs;                      /* Page 1 in this transaction */
+  PgHdr *pPg;                     /* Cached page 1 */
+  u32 iFrame = 0;                 /* Frame containing page 1 */
+  int i;
+  int rc;
+
+  assert( pagerUseWal(pPager) && aBase );
+  rc = sqlite3WalFindFrame(pPager->pWal, 1, &iFrame);
+  if( rc!=SQLITE_OK ) return rc;
+  if( NEVER(iFrame==0) ) return SQLITE_BUSY_SNAPSHOT;
+  rc = sqlite3WalReadFrame(pPager->pWal, iFrame, pgsz, aNew);
+  if( rc!=SQLITE_OK ) return rc;
+  CODEC1(pPager, aNew, 1, 3, return SQLITE_NOMEM);
+
+  if( memcmp(aBase, aNew, 24)
+   || memcmp(&aBase[40], &aNew[40], 92-40)
+   || memcmp(&aBase[100], &aNew[100], pgsz-100)
+  ){
+    return SQLITE_BUSY_SNAPSHOT;
+  }
+
+  /* Page 1 is referenced by the b-tree layer throughout the transaction,
+  ** so it is always found in the cache.  */
+  pPg = sqlite3PagerLookup(pPager, 1);
+  if( NEVER(pPg==0) ) return SQLITE_BUSY_SNAPSHOT;
+  aOurs = (u8*)pPg->pData;
+  for(i=0; i<ArraySize(aField); i++){
+    int iOff = aField[i].iOff;
+    int n = aField[i].nByte;
+    if( memcmp(&aBase[iOff], &aNew[iOff], n) 
+     && memcmp(&aBase[iOff], &aOurs[iOff], n)
+    ){
+      rc = SQLITE_BUSY_SNAPSHOT;
+    }
+  }
+  if( rc==SQLITE_OK && memcmp(&aBase[28], &aNew[28], 4) ){
+    /* The other transactions changed the size of the database. This one
+    ** did not, so it takes the size of the new snapshot.  */
+    if( pPager->dbSize!=pPager->dbOrigSize ){
+      rc = SQLITE_BUSY_SNAPSHOT;
+    }else{
+      Pgno nNew = sqlite3WalDbsize(pPager->pWal);
+      pPager->dbSize = pPager->dbOrigSize = nNew;
+      pPager->dbFileSize = pPager->dbHintSize = nNew;
+    }
+  }
+  if( rc==SQLITE_OK ){
+    for(i=0; i<ArraySize(aField); i++){
+      int iOff = aField[i].iOff;
+      if( memcmp(&aBase[iOff], &aNew[iOff], aField[i].nByte) ){
+        memcpy(&aOurs[iOff], &aNew[iOff], aField[i].nByte);
+      }
+    }
+    for(i=0; i<ArraySize(aCommit); i++){
+      memcpy(&aOurs[aCommit[i].iOff], &aNew[aCommit[i].iOff], aCommit[i].nByte);
+    }
+    memcpy(aBase, aNew, pgsz);
+    memcpy(&pPager->dbFileVers, &aOurs[24], sizeof(pPager->dbFileVers));
+  }
+  sqlite3PagerUnref(pPg);
+  return rc;
+}
+
+/*
+** This function is passed as the xUndo callback to sqlite3WalLockForCommit()
+** at the end of a concurrent transaction. It is invoked for each page
+** written by the transactions committed since this one began. Page 1 is
+** merged with the version in the cache by pagerMergePage1(). Any other
+** page was not used by this transaction, so only stale copies of it are
+** discarded from the cache.
+*/
+static int pagerConcurrentUndo(void *pCtx, Pgno iPg){
+  if( iPg==1 ){
+    return pagerMergePage1((Pager *)pCtx);
+  }
+  return pagerUndoCallback(pCtx, iPg);
+}
+
 /*
 ** This function is called to rollback a transaction on a WAL database.
 */
@@ -4117,18 +4346,30 @@ static int syncJournal(Pager *pPager, int newHdr){
         ** for garbage data to be appended to the file, the nRec field
         ** is populated with 0xFFFFFFFF when the journal header is written
         ** and never needs to be updated.
+        **
+        ** If the header was written by a pipelined commit, nRec is already
+        ** 0xFFFFFFFF and the page record checksums are relied upon to
+        ** detect garbage. So nRec is only written if a new journal header
+        ** is to follow. In this case the extra sync is not done either.
+        ** The new header is still required, as it begins on a sector
+        ** boundary, so that no page record written after this sync shares
+        ** a sector with one written before it.
         */
-        if( pPager->fullSync && 0==(iDc&SQLITE_IOCAP_SEQUENTIAL) ){
-          PAGERTRACE(("SYNC journal of %d\n", PAGERID(pPager)));
-          IOTRACE(("JSYNC %p\n", pPager))
-          rc = sqlite3OsSync(pPager->jfd, pPager->syncFlags);
+        if( pPager->pipelineHdr==0 || newHdr ){
+          if( pPager->fullSync && pPager->pipelineHdr==0
+           && 0==(iDc&SQLITE_IOCAP_SEQUENTIAL) 
+          ){
+            PAGERTRACE(("SYNC journal of %d\n", PAGERID(pPager)));
+            IOTRACE(("JSYNC %p\n", pPager))
+            rc = sqlite3OsSync(pPager->jfd, pPager->syncFlags);
+            if( rc!=SQLITE_OK ) return rc;
+          }
+          IOTRACE(("JHDR %p %lld\n", pPager, pPager->journalHdr));
+          rc = sqlite3OsWrite(
+              pPager->jfd, zHeader, sizeof(zHeader), pPager->journalHdr
+          );
           if( rc!=SQLITE_OK ) return rc;
         }
-        IOTRACE(("JHDR %p %lld\n", pPager, pPager->journalHdr));
-        rc = sqlite3OsWrite(
-            pPager->jfd, zHeader, sizeof(zHeader), pPager->journalHdr
-        );
-        if( rc!=SQLITE_OK ) return rc;
       }
       if( 0==(iDc&SQLITE_IOCAP_SEQUENTIAL) ){
         PAGERTRACE(("SYNC journal of %d\n", PAGERID(pPager)));
@@ -4160,6 +4401,59 @@ static int syncJournal(Pager *pPager, int newHdr){
   return SQLITE_OK;
 }
 
+/*
+** The maximum number of pages that pager_write_pagelist() passes to a 
+** single call to sqlite3OsWritev().
+*/
+#define PAGER_WRITEV_MAX 32
+
+/*
+** If "PRAGMA journal_pipeline" is enabled, the VFS is asked to start
+** writing pages to persistent storage (see SQLITE_FCNTL_WRITEBACK) each
+** time this many bytes have been written to the database file by
+** pager_write_pagelist(). This way much of the data is already on its
+** way to disk when the database file is synced.
+*/
+#ifndef PAGER_WRITEBACK_SIZE
+# define PAGER_WRITEBACK_SIZE (1024*1024)
+#endif
+
+/*
+** Write the nRun pages of data in apRun[] to the database file, starting
+** at page iRun.
+**
+** If piWriteback is not NULL, *piWriteback is the offset of the start
+** of the region written since the last SQLITE_FCNTL_WRITEBACK hint, or
+** -1 if nothing has been written since. It is updated by this function.
+*/
+static int pagerWriteRun(
+  Pager *pPager,                  /* Pager object */
+  Pgno iRun,                      /* Page number of apRun[0] */
+  int nRun,                       /* Number of pages to write */
+  const void **apRun,             /* Page data */
+  i64 *piWriteback                /* IN/OUT: Start of unhinted region */
+){
+  i64 offset = (iRun-1)*(i64)pPager->pageSize;
+  i64 iEnd = offset + nRun*(i64)pPager->pageSize;
+  int rc;
+  if( nRun==1 ){
+    rc = sqlite3OsWrite(pPager->fd, apRun[0], pPager->pageSize, offset);
+  }else{
+    rc = sqlite3OsWritev(pPager->fd, nRun, apRun, pPager->pageSize, offset);
+  }
+  if( rc==SQLITE_OK && piWriteback ){
+    if( *piWriteback<0 ) *piWriteback = offset;
+    if( iEnd-*piWriteback>=PAGER_WRITEBACK_SIZE ){
+      i64 aRange[2];
+      aRange[0] = *piWriteback;
+      aRange[1] = iEnd - *piWriteback;
+      sqlite3OsFileControlHint(pPager->fd, SQLITE_FCNTL_WRITEBACK, aRange);
+      *piWriteback = -1;
+    }
+  }
+  return rc;
+}
+
 /*
 ** The argument is the first in a linked list of dirty pages connected
 ** by the PgHdr.pDirty pointer. This function writes each one of the
@@ -4177,8 +4471,10 @@ static int syncJournal(Pager *pPager, int newHdr){
 ** written out.
 **
 ** Once the lock has been upgraded and, if necessary, the file opened,
-** the pages are written out to the database file in list order. Writing
-** a page is skipped if it meets either of the following criteria:
+** the pages are written out to the database file in list order. Runs of
+** pages with consecutive page numbers are written using a single call
+** to sqlite3OsWritev(). Writing a page is skipped if it meets either of
+** the following criteria:
 **
 **   * The page number is greater than Pager.dbSize, or
 **   * The PGHDR_DONT_WRITE flag is set on the page.
@@ -4194,6 +4490,11 @@ static int syncJournal(Pager *pPager, int newHdr){
 */
 static int pager_write_pagelist(Pager *pPager, PgHdr *pList){
   int rc = SQLITE_OK;                  /* Return code */
+  Pgno iRun = 0;                       /* First page of current run */
+  int nRun = 0;                        /* Number of pages in current run */
+  const void *apRun[PAGER_WRITEV_MAX]; /* Data for each page of the run */
+  i64 iWriteback = -1;                 /* Start of unhinted region */
+  i64 *piWriteback = 0;                /* &iWriteback if pipelined */
 
   /* This function is only called for rollback pagers in WRITER_DBMOD state. */
   assert( !pagerUseWal(pPager) );
@@ -4220,6 +4521,9 @@ static int pager_write_pagelist(Pager *pPager, PgHdr *pList){
     sqlite3OsFileControlHint(pPager->fd, SQLITE_FCNTL_SIZE_HINT, &szFile);
     pPager->dbHintSize = pPager->dbSize;
   }
+  if( pPager->journalPipeline && !pPager->noSync ){
+    piWriteback = &iWriteback;
+  }
 
   while( rc==SQLITE_OK && pList ){
     Pgno pgno = pList->pgno;
@@ -4233,21 +4537,37 @@ static int pager_write_pagelist(Pager *pPager, PgHdr *pList){
     ** set (set by sqlite3PagerDontWrite()).
     */
     if( pgno<=pPager->dbSize && 0==(pList->flags&PGHDR_DONT_WRITE) ){
-      i64 offset = (pgno-1)*(i64)pPager->pageSize;   /* Offset to write */
       char *pData;                                   /* Data to write */    
 
       assert( (pList->flags&PGHDR_NEED_SYNC)==0 );
       if( pList->pgno==1 ) pager_write_changecounter(pList);
 
+      /* If this page does not follow on from the current run, write the
+      ** run out before starting a new one. */
+      if( nRun>0 && (pgno!=iRun+nRun || nRun==PAGER_WRITEV_MAX) ){
+        rc = pagerWriteRun(pPager, iRun, nRun, apRun, piWriteback);
+        nRun = 0;
+        if( rc!=SQLITE_OK ) break;
+      }
+
       /* Encode the database */
       CODEC2(pPager, pList->pData, pgno, 6, return SQLITE_NOMEM, pData);
 
-      /* Write out the page data. */
-      rc = sqlite3OsWrite(pPager->fd, pData, pPager->pageSize, offset);
+      /* Add the page to the run. The encoded data for a page is only 
+      ** valid until the codec is next invoked, so if there is a codec the
+      ** page is written out immediately. */
+      if( nRun==0 ) iRun = pgno;
+      apRun[nRun++] = pData;
+#ifdef SQLITE_HAS_CODEC
+      if( pPager->xCodec ){
+        rc = pagerWriteRun(pPager, iRun, nRun, apRun, piWriteback);
+        nRun = 0;
+      }
+#endif
 
-      /* If page 1 was just written, update Pager.dbFileVers to match
-      ** the value now stored in the database file. If writing this 
-      ** page caused the database file to grow, update dbFileSize. 
+      /* If page 1 is being written, update Pager.dbFileVers to match
+      ** the value stored in the database file. If writing this page 
+      ** causes the database file to grow, update dbFileSize. 
       */
       if( pgno==1 ){
         memcpy(&pPager->dbFileVers, &pData[24], sizeof(pPager->dbFileVers));
@@ -4270,6 +4590,9 @@ static int pager_write_pagelist(Pager *pPager, PgHdr *pList){
     pager_set_pagehash(pList);
     pList = pList->pDirty;
   }
+  if( rc==SQLITE_OK && nRun>0 ){
+    rc = pagerWriteRun(pPager, iRun, nRun, apRun, piWriteback);
+  }
 
   return rc;
 }
@@ -4392,6 +4715,14 @@ static int pagerStress(void *p, PgHdr *pPg){
     return SQLITE_OK;
   }
 
+  /* A concurrent transaction may not write to the log before it commits,
+  ** as it does not hold the WAL write lock. Its dirty pages must all fit
+  ** in the cache. Once they do not, the statement fails with SQLITE_FULL,
+  ** so that the cache does not grow beyond the configured cache_size.  */
+  if( pPager->pAllRead ){
+    return SQLITE_FULL;
+  }
+
   pPg->pDirty = 0;
   if( pagerUseWal(pPager) ){
     /* Write a single frame for this page to the log. */
@@ -4715,6 +5046,11 @@ int sqlite3PagerOpen(
   nExtra = ROUND8(nExtra);
   sqlite3PcacheOpen(szPageDflt, nExtra, !memDb,
                     !memDb?pagerStress:0, (void *)pPager, pPager->pPCache);
+  if( isOpen(pPager->fd) ){
+    int szAlign = 0;
+    sqlite3OsFileControlHint(pPager->fd, SQLITE_FCNTL_BUFFER_ALIGN, &szAlign);
+    sqlite3PcacheSetAlign(pPager->pPCache, szAlign);
+  }
 
   PAGERTRACE(("OPEN %d %s\n", FILEHANDLEID(pPager->fd), pPager->zFilename));
   IOTRACE(("OPEN %p %s\n", pPager, pPager->zFilename))
@@ -4758,6 +5094,7 @@ int sqlite3PagerOpen(
   /* pPager->pLast = 0; */
   pPager->nExtra = (u16)nExtra;
   pPager->journalSizeLimit = SQLITE_DEFAULT_JOURNAL_SIZE_LIMIT;
+  pPager->nReadahead = tempFile ? 0 : SQLITE_DEFAULT_READAHEAD;
   assert( isOpen(pPager->fd) || tempFile );
   setSectorSize(pPager);
   if( !useJournal ){
@@ -5235,6 +5572,9 @@ int sqlite3PagerAcquire(
   if( pgno==0 ){
     return SQLITE_CORRUPT_BKPT;
   }
+  if( pPager->pAllRead && sqlite3BitvecSet(pPager->pAllRead, pgno) ){
+    return SQLITE_NOMEM;
+  }
 
   /* If the pager is in the error state, return an error immediately. 
   ** Otherwise, request the page from the PCache layer. */
@@ -5488,6 +5828,41 @@ static int pager_open_journal(Pager *pPager){
   return rc;
 }
 
+/*
+** This function is called just after a read transaction has been opened
+** on a pager in WAL mode as part of a transaction started with BEGIN
+** CONCURRENT. It arranges for a subsequent call to sqlite3PagerBegin()
+** to open a write transaction without taking the WAL write lock, which
+** allows other connections to write to the database at the same time.
+** The number of each page used by the transaction is recorded so that
+** conflicts with transactions committed by other connections can be
+** detected when the write lock is finally taken at commit time.
+**
+** If the pager is not in WAL mode, or is in exclusive locking mode, this
+** function is a no-op and the transaction is an ordinary one.
+*/
+int sqlite3PagerBeginConcurrent(Pager *pPager){
+  int rc = SQLITE_OK;
+  assert( pPager->eState==PAGER_READER );
+  if( pagerUseWal(pPager) && pPager->exclusiveMode==0 && !pPager->pAllRead ){
+    DbPage *pPage1 = 0;
+    pPager->pAllRead = sqlite3BitvecCreate(pPager->mxPgno);
+    pPager->aPage1Base = (u8*)sqlite3Malloc(pPager->pageSize);
+    if( pPager->pAllRead==0 || pPager->aPage1Base==0 ){
+      rc = SQLITE_NOMEM;
+    }else{
+      /* Keep a copy of page 1 for pagerMergePage1() */
+      rc = sqlite3PagerGet(pPager, 1, &pPage1);
+      if( rc==SQLITE_OK ){
+        memcpy(pPager->aPage1Base, pPage1->pData, pPager->pageSize);
+        sqlite3PagerUnref(pPage1);
+      }
+    }
+    if( rc!=SQLITE_OK ) pagerEndConcurrent(pPager);
+  }
+  return rc;
+}
+
 /*
 ** Begin a write-transaction on the specified pager object. If a 
 ** write-transaction has already been opened, this function is a no-op.
@@ -5531,8 +5906,13 @@ int sqlite3PagerBegin(Pager *pPager, int exFlag, int subjInMemory){
       ** PAGER_RESERVED state. Otherwise, return an error code to the caller.
       ** The busy-handler is not invoked if another connection already
       ** holds the write-lock. If possible, the upper layer will call it.
+      **
+      ** A concurrent transaction does not take the write-lock until it
+      ** is committed (see pagerLockForCommit()).
       */
-      rc = sqlite3WalBeginWriteTransaction(pPager->pWal);
+      if( pPager->pAllRead==0 ){
+        rc = sqlite3WalBeginWriteTransaction(pPager->pWal);
+      }
     }else{
       /* Obtain a RESERVED lock on the database file. If the exFlag parameter
       ** is true, then immediately upgrade this to an EXCLUSIVE lock. The
@@ -5994,6 +6374,26 @@ int sqlite3PagerExclusiveLock(Pager *pPager){
   return rc;
 }
 
+#ifndef SQLITE_OMIT_WAL
+/*
+** Obtain the WAL write lock at the end of a concurrent write transaction
+** (see sqlite3PagerBeginConcurrent()), invoking the busy-handler while it
+** is held by another connection. SQLITE_BUSY_SNAPSHOT is returned if the
+** transaction conflicts with one committed since it began, in which case
+** it must be rolled back.
+*/
+static int pagerLockForCommit(Pager *pPager){
+  int rc;
+  assert( pagerUseWal(pPager) && pPager->pAllRead );
+  do{
+    rc = sqlite3WalLockForCommit(
+        pPager->pWal, pPager->pAllRead, pagerConcurrentUndo, (void *)pPager
+    );
+  }while( rc==SQLITE_BUSY && pPager->xBusyHandler(pPager->pBusyHandlerArg) );
+  return rc;
+}
+#endif
+
 /*
 ** Sync the database file for the pager pPager. zMaster points to the name
 ** of a master journal file that should be written into the individual
@@ -6061,7 +6461,10 @@ int sqlite3PagerCommitPhaseOne(
         pList->pDirty = 0;
       }
       assert( rc==SQLITE_OK );
-      if( ALWAYS(pList) ){
+      if( pPager->pAllRead ){
+        rc = pagerLockForCommit(pPager);
+      }
+      if( rc==SQLITE_OK && ALWAYS(pList) ){
         rc = pagerWalFrames(pPager, pList, pPager->dbSize, 1);
       }
       sqlite3PagerUnref(pPageOne);
@@ -6309,6 +6712,15 @@ u8 sqlite3PagerIsreadonly(Pager *pPager){
   return pPager->readOnly;
 }
 
+/*
+** Return a value that changes whenever the content of the page cache is
+** discarded, for example because another connection has modified the
+** database file or a hot journal was rolled back.
+*/
+u32 sqlite3PagerDataVersion(Pager *pPager){
+  return pPager->iDataVersion;
+}
+
 /*
 ** Return the number of references to the pager.
 */
@@ -6357,22 +6769,26 @@ int *sqlite3PagerStats(Pager *pPager){
 #endif
 
 /*
-** Parameter eStat must be either SQLITE_DBSTATUS_CACHE_HIT or
-** SQLITE_DBSTATUS_CACHE_MISS. Before returning, *pnVal is incremented by the
-** current cache hit or miss count, according to the value of eStat. If the 
-** reset parameter is non-zero, the cache hit or miss count is zeroed before 
-** returning.
+** Parameter eStat must be one of SQLITE_DBSTATUS_CACHE_HIT, CACHE_MISS,
+** CACHE_WRITE, READAHEAD_HIT or READAHEAD_WASTE. Before returning, *pnVal
+** is incremented by the current value of the corresponding counter. If
+** the reset parameter is non-zero, the counter is zeroed before returning.
 */
 void sqlite3PagerCacheStat(Pager *pPager, int eStat, int reset, int *pnVal){
 
   assert( eStat==SQLITE_DBSTATUS_CACHE_HIT
        || eStat==SQLITE_DBSTATUS_CACHE_MISS
        || eStat==SQLITE_DBSTATUS_CACHE_WRITE
+       || eStat==SQLITE_DBSTATUS_READAHEAD_HIT
+       || eStat==SQLITE_DBSTATUS_READAHEAD_WASTE
   );
 
   assert( SQLITE_DBSTATUS_CACHE_HIT+1==SQLITE_DBSTATUS_CACHE_MISS );
   assert( SQLITE_DBSTATUS_CACHE_HIT+2==SQLITE_DBSTATUS_CACHE_WRITE );
+  assert( SQLITE_DBSTATUS_CACHE_HIT+3==SQLITE_DBSTATUS_READAHEAD_HIT );
+  assert( SQLITE_DBSTATUS_CACHE_HIT+4==SQLITE_DBSTATUS_READAHEAD_WASTE );
   assert( PAGER_STAT_HIT==0 && PAGER_STAT_MISS==1 && PAGER_STAT_WRITE==2 );
+  assert( PAGER_STAT_RA_HIT==3 && PAGER_STAT_RA_WASTE==4 );
 
   *pnVal += pPager->aStat[eStat - SQLITE_DBSTATUS_CACHE_HIT];
   if( reset ){
@@ -6917,6 +7333,49 @@ int sqlite3PagerOkToChangeJournalMode(Pager *pPager){
   return 1;
 }
 
+/*
+** Get/set the maximum number of pages read ahead of a sequential scan
+** of the database file. A value of zero disables read-ahead. An attempt
+** to set a negative value is a no-op.
+*/
+int sqlite3PagerReadahead(Pager *pPager, int nPage){
+  if( nPage>=0 && !pPager->tempFile ){
+    pPager->nReadahead = nPage;
+  }
+  return pPager->nReadahead;
+}
+
+/*
+** Get/set the "PRAGMA journal_pipeline" flag. If it is set, commits in
+** PERSIST or TRUNCATE journal mode do not update the journal header
+** after writing the page records (see writeJournalHdr()), and ask the
+** VFS to start writing back database pages before the final sync. An
+** argument less than zero is a no-op.
+*/
+int sqlite3PagerJournalPipeline(Pager *pPager, int bEnable){
+  if( bEnable>=0 && !pPager->tempFile && !MEMDB ){
+    pPager->journalPipeline = (u8)(bEnable!=0);
+  }
+  return (int)pPager->journalPipeline;
+}
+
+/*
+** Get/set the number of worker threads, in addition to the calling
+** thread, that a checkpoint of the WAL file may use to write to the
+** database file. An attempt to set a negative value is a no-op. Values
+** larger than SQLITE_MAX_WORKER_THREADS are reduced to that limit.
+*/
+int sqlite3PagerCheckpointThreads(Pager *pPager, int nThread){
+  if( nThread>=0 ){
+    if( nThread>SQLITE_MAX_WORKER_THREADS ){
+      nThread = SQLITE_MAX_WORKER_THREADS;
+    }
+    pPager->nCkptThread = nThread;
+    sqlite3WalCheckpointThreads(pPager->pWal, nThread);
+  }
+  return pPager->nCkptThread;
+}
+
 /*
 ** Get/set the size-limit used for persistent journal files.
 **
@@ -7031,6 +7490,9 @@ static int pagerOpenWal(Pager *pPager){
         pPager->journalSizeLimit, &pPager->pWal
     );
   }
+  if( rc==SQLITE_OK ){
+    sqlite3WalCheckpointThreads(pPager->pWal, pPager->nCkptThread);
+  }
   pagerFixMaplimit(pPager);
 
   return rc;
@@ -26,6 +26,16 @@
   #define SQLITE_DEFAULT_JOURNAL_SIZE_LIMIT -1
 #endif
 
+/*
+** Default maximum number of pages to read ahead of a sequential scan of
+** the database file. Zero disables read-ahead. This value may be
+** overridden using the sqlite3PagerReadahead() API. See also
+** "PRAGMA readahead".
+*/
+#ifndef SQLITE_DEFAULT_READAHEAD
+  #define SQLITE_DEFAULT_READAHEAD 64
+#endif
+
 /*
 ** The type used to represent a page number.  The first page in a file
 ** is called page 1.  0 is used to represent "not a page".
@@ -109,6 +119,9 @@ int sqlite3PagerSetPagesize(Pager*, u32*, int);
 int sqlite3PagerMaxPageCount(Pager*, int);
 void sqlite3PagerSetCachesize(Pager*, int);
 void sqlite3PagerSetMmapLimit(Pager *, sqlite3_int64);
+int sqlite3PagerReadahead(Pager*, int);
+int sqlite3PagerCheckpointThreads(Pager*, int);
+int sqlite3PagerJournalPipeline(Pager*, int);
 void sqlite3PagerShrink(Pager*);
 void sqlite3PagerSetSafetyLevel(Pager*,int,int,int);
 int sqlite3PagerLockingMode(Pager *, int);
@@ -136,6 +149,7 @@ void *sqlite3PagerGetExtra(DbPage *);
 /* Functions used to manage pager transactions and savepoints. */
 void sqlite3PagerPagecount(Pager*, int*);
 int sqlite3PagerBegin(Pager*, int exFlag, int);
+int sqlite3PagerBeginConcurrent(Pager*);
 int sqlite3PagerCommitPhaseOne(Pager*,const char *zMaster, int);
 int sqlite3PagerExclusiveLock(Pager*);
 int sqlite3PagerSync(Pager *pPager);
@@ -160,6 +174,7 @@ int sqlite3PagerSharedLock(Pager *pPager);
 /* Functions used to query pager state and configuration. */
 u8 sqlite3PagerIsreadonly(Pager*);
 int sqlite3PagerRefcount(Pager*);
+u32 sqlite3PagerDataVersion(Pager*);
 int sqlite3PagerMemUsed(Pager*);
 const char *sqlite3PagerFilename(Pager*, int);
 const sqlite3_vfs *sqlite3PagerVfs(Pager*);
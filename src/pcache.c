@@ -28,6 +28,7 @@ struct PCache {
   void *pStress;                      /* Argument to xStress */
   sqlite3_pcache *pCache;             /* Pluggable cache module */
   PgHdr *pPage1;                      /* Reference to page 1 */
+  int szAlign;                        /* Requested page buffer alignment */
 };
 
 /*
@@ -198,6 +199,17 @@ void sqlite3PcacheSetPageSize(PCache *pCache, int szPage){
   pCache->szPage = szPage;
 }
 
+/*
+** Request that page buffers be aligned to szAlign bytes, or not aligned
+** if szAlign is zero. This only has an effect if the default page cache
+** implementation is in use. The request applies to the pluggable cache
+** created next, so it must be made before the first page is fetched.
+*/
+void sqlite3PcacheSetAlign(PCache *pCache, int szAlign){
+  assert( pCache->pCache==0 );
+  pCache->szAlign = szAlign;
+}
+
 /*
 ** Compute the number of pages of cache requested.
 */
@@ -237,6 +249,9 @@ int sqlite3PcacheFetch(
     if( !p ){
       return SQLITE_NOMEM;
     }
+    if( pCache->szAlign ){
+      sqlite3PCache1SetAlign(p, pCache->szAlign);
+    }
     sqlite3GlobalConfig.pcache2.xCachesize(p, numberOfCachePages(pCache));
     pCache->pCache = p;
   }
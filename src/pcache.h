@@ -80,6 +80,11 @@ void sqlite3PcacheOpen(
 /* Modify the page-size after the cache has been created. */
 void sqlite3PcacheSetPageSize(PCache *, int);
 
+/* Request page buffers aligned for direct I/O. The second routine is
+** the part implemented by the default pluggable cache. */
+void sqlite3PcacheSetAlign(PCache *, int);
+void sqlite3PCache1SetAlign(sqlite3_pcache *, int);
+
 /* Return the size in bytes of a PCache object.  Used to preallocate
 ** storage space.
 */
@@ -23,6 +23,7 @@ typedef struct PCache1 PCache1;
 typedef struct PgHdr1 PgHdr1;
 typedef struct PgFreeslot PgFreeslot;
 typedef struct PGroup PGroup;
+typedef struct PgSlab PgSlab;
 
 /* Each page cache (or PCache) belongs to a PGroup.  A PGroup is a set 
 ** of one or more PCaches that are able to recycle each others unpinned
@@ -85,6 +86,13 @@ struct PCache1 {
   unsigned int nPage;                 /* Total number of pages in apHash */
   unsigned int nHash;                 /* Number of slots in apHash[] */
   PgHdr1 **apHash;                    /* Hash table for fast lookup by key */
+
+  /* If szAlign is not zero, page buffers are aligned to szAlign bytes.
+  ** They are allocated from the slabs in the pSlab list, which may only
+  ** be accessed while holding the PGroup mutex. See pcache1SlabAlloc().
+  */
+  int szAlign;                        /* Page buffer alignment, or 0 */
+  PgSlab *pSlab;                      /* List of slabs */
 };
 
 /*
@@ -110,6 +118,30 @@ struct PgFreeslot {
   PgFreeslot *pNext;  /* Next free slot */
 };
 
+/*
+** A slab is a single allocation divided into nSlot page buffers that
+** are aligned to PCache1.szAlign bytes. Aligned caches allocate their
+** page buffers from slabs so that the alignment padding is paid once
+** per slab instead of once per page.
+*/
+struct PgSlab {
+  PgSlab *pNext;      /* Next slab belonging to the same cache */
+  u8 *aSlot;          /* First page buffer in the slab */
+  int nSlot;          /* Number of page buffers in the slab */
+  int nUsed;          /* Number of page buffers currently in use */
+  PgFreeslot *pFree;  /* List of unused page buffers */
+};
+
+/*
+** The largest slab allocated is PCACHE1_SLAB_SZ bytes, not counting
+** the alignment padding. A new slab holds as many pages as the cache
+** already contains, so that the number of slabs grows logarithmically
+** with the size of the cache, but never fewer than 4 pages.
+*/
+#ifndef PCACHE1_SLAB_SZ
+# define PCACHE1_SLAB_SZ 262144
+#endif
+
 /*
 ** Global data used by this cache.
 */
@@ -274,6 +306,81 @@ static int pcache1MemSize(void *p){
 }
 #endif /* SQLITE_ENABLE_MEMORY_MANAGEMENT */
 
+/*
+** Allocate a page buffer aligned to pCache->szAlign bytes from one of
+** the slabs belonging to pCache. If no slab has an unused buffer, a
+** new slab is allocated. Return NULL if this fails.
+**
+** The group mutex must be held when this function is called. It is
+** released while a new slab is allocated, for the same reason as in
+** pcache1AllocPage().
+*/
+static void *pcache1SlabAlloc(PCache1 *pCache){
+  PgSlab *pSlab;
+  PgFreeslot *pSlot;
+
+  assert( sqlite3_mutex_held(pCache->pGroup->mutex) );
+  assert( pCache->szAlign>0 && (pCache->szPage % pCache->szAlign)==0 );
+  for(pSlab=pCache->pSlab; pSlab && pSlab->pFree==0; pSlab=pSlab->pNext);
+  if( pSlab==0 ){
+    int szPage = pCache->szPage;
+    int szAlign = pCache->szAlign;
+    int nSlot = (int)pCache->nPage;
+    int i;
+    if( nSlot>PCACHE1_SLAB_SZ/szPage ) nSlot = PCACHE1_SLAB_SZ/szPage;
+    if( nSlot<4 ) nSlot = 4;
+    pcache1LeaveMutex(pCache->pGroup);
+    pSlab = (PgSlab*)pcache1Alloc(sizeof(PgSlab) + szAlign + nSlot*szPage);
+    pcache1EnterMutex(pCache->pGroup);
+    if( pSlab==0 ) return 0;
+    pSlab->aSlot = (u8*)&pSlab[1];
+    pSlab->aSlot += (szAlign - SQLITE_PTR_TO_INT(pSlab->aSlot)) & (szAlign-1);
+    pSlab->nSlot = nSlot;
+    pSlab->nUsed = 0;
+    pSlab->pFree = 0;
+    for(i=nSlot-1; i>=0; i--){
+      pSlot = (PgFreeslot*)&pSlab->aSlot[i*szPage];
+      pSlot->pNext = pSlab->pFree;
+      pSlab->pFree = pSlot;
+    }
+    pSlab->pNext = pCache->pSlab;
+    pCache->pSlab = pSlab;
+  }
+  pSlot = pSlab->pFree;
+  pSlab->pFree = pSlot->pNext;
+  pSlab->nUsed++;
+  return (void*)pSlot;
+}
+
+/*
+** Return page buffer pBuf, obtained from pcache1SlabAlloc(), to its slab.
+** The slab is freed if none of its buffers remain in use.
+**
+** The group mutex must be held when this function is called.
+*/
+static void pcache1SlabFree(PCache1 *pCache, void *pBuf){
+  PgSlab **pp;
+  PgSlab *pSlab;
+  PgFreeslot *pSlot = (PgFreeslot*)pBuf;
+
+  assert( sqlite3_mutex_held(pCache->pGroup->mutex) );
+  for(pp=&pCache->pSlab; (pSlab = *pp)!=0; pp=&pSlab->pNext){
+    if( (u8*)pBuf>=pSlab->aSlot
+     && (u8*)pBuf<&pSlab->aSlot[pSlab->nSlot*pCache->szPage]
+    ){
+      break;
+    }
+  }
+  assert( pSlab && pSlab->nUsed>0 );
+  pSlot->pNext = pSlab->pFree;
+  pSlab->pFree = pSlot;
+  pSlab->nUsed--;
+  if( pSlab->nUsed==0 ){
+    *pp = pSlab->pNext;
+    pcache1Free(pSlab);
+  }
+}
+
 /*
 ** Allocate a new page object initially associated with cache pCache.
 */
@@ -286,19 +393,30 @@ static PgHdr1 *pcache1AllocPage(PCache1 *pCache){
   ** this mutex is not held. */
   assert( sqlite3_mutex_held(pCache->pGroup->mutex) );
   pcache1LeaveMutex(pCache->pGroup);
+  if( pCache->szAlign ){
+    /* An aligned page buffer is allocated from a slab. The page header
+    ** is always allocated separately. */
+    p = sqlite3Malloc(sizeof(PgHdr1) + pCache->szExtra);
+    pcache1EnterMutex(pCache->pGroup);
+    pPg = p ? pcache1SlabAlloc(pCache) : 0;
+    if( !pPg ){
+      sqlite3_free(p);
+    }
+  }else{
 #ifdef SQLITE_PCACHE_SEPARATE_HEADER
-  pPg = pcache1Alloc(pCache->szPage);
-  p = sqlite3Malloc(sizeof(PgHdr1) + pCache->szExtra);
-  if( !pPg || !p ){
-    pcache1Free(pPg);
-    sqlite3_free(p);
-    pPg = 0;
-  }
+    pPg = pcache1Alloc(pCache->szPage);
+    p = sqlite3Malloc(sizeof(PgHdr1) + pCache->szExtra);
+    if( !pPg || !p ){
+      pcache1Free(pPg);
+      sqlite3_free(p);
+      pPg = 0;
+    }
 #else
-  pPg = pcache1Alloc(sizeof(PgHdr1) + pCache->szPage + pCache->szExtra);
-  p = (PgHdr1 *)&((u8 *)pPg)[pCache->szPage];
+    pPg = pcache1Alloc(sizeof(PgHdr1) + pCache->szPage + pCache->szExtra);
+    p = (PgHdr1 *)&((u8 *)pPg)[pCache->szPage];
 #endif
-  pcache1EnterMutex(pCache->pGroup);
+    pcache1EnterMutex(pCache->pGroup);
+  }
 
   if( pPg ){
     p->page.pBuf = pPg;
@@ -322,10 +440,15 @@ static void pcache1FreePage(PgHdr1 *p){
   if( ALWAYS(p) ){
     PCache1 *pCache = p->pCache;
     assert( sqlite3_mutex_held(p->pCache->pGroup->mutex) );
-    pcache1Free(p->page.pBuf);
+    if( pCache->szAlign ){
+      pcache1SlabFree(pCache, p->page.pBuf);
+      sqlite3_free(p);
+    }else{
+      pcache1Free(p->page.pBuf);
 #ifdef SQLITE_PCACHE_SEPARATE_HEADER
-    sqlite3_free(p);
+      sqlite3_free(p);
 #endif
+    }
     if( pCache->bPurgeable ){
       pCache->pGroup->nCurrentPage--;
     }
@@ -785,7 +908,11 @@ static sqlite3_pcache_page *pcache1Fetch(
     assert( (pOther->szPage & (pOther->szPage-1))==0 && pOther->szPage>=512 );
     assert( pOther->szExtra<512 );
 
-    if( pOther->szPage+pOther->szExtra != pCache->szPage+pCache->szExtra ){
+    /* A page buffer allocated from a slab belongs to the slab's cache, so
+    ** it may not be passed to a different cache. */
+    if( pOther->szPage+pOther->szExtra != pCache->szPage+pCache->szExtra
+     || (pOther!=pCache && (pOther->szAlign || pCache->szAlign))
+    ){
       pcache1FreePage(pPage);
       pPage = 0;
     }else{
@@ -936,10 +1063,29 @@ static void pcache1Destroy(sqlite3_pcache *p){
   pGroup->mxPinned = pGroup->nMaxPage + 10 - pGroup->nMinPage;
   pcache1EnforceMaxPage(pGroup);
   pcache1LeaveMutex(pGroup);
+  assert( pCache->pSlab==0 );
   sqlite3_free(pCache->apHash);
   sqlite3_free(pCache);
 }
 
+/*
+** Arrange for the page buffers of cache p to be aligned to szAlign
+** bytes, a power of two. This is used for databases opened for direct
+** I/O (see SQLITE_FCNTL_BUFFER_ALIGN). It must be called before any page
+** is allocated. It is a no-op if szAlign is zero or does not divide the
+** page size, or if p is not a cache created by this module.
+*/
+void sqlite3PCache1SetAlign(sqlite3_pcache *p, int szAlign){
+  PCache1 *pCache = (PCache1 *)p;
+  assert( szAlign>=0 && (szAlign & (szAlign-1))==0 );
+  if( sqlite3GlobalConfig.pcache2.xCreate==pcache1Create
+   && szAlign>0 && (pCache->szPage % szAlign)==0
+  ){
+    assert( pCache->nPage==0 && pCache->pSlab==0 );
+    pCache->szAlign = szAlign;
+  }
+}
+
 /*
 ** This function is called during initialization (sqlite3_initialize()) to
 ** install the default pluggable cache module, assuming the user has not
@@ -982,10 +1128,15 @@ int sqlite3PcacheReleaseMemory(int nReq){
     PgHdr1 *p;
     pcache1EnterMutex(&pcache1.grp);
     while( (nReq<0 || nFree<nReq) && ((p=pcache1.grp.pLruTail)!=0) ){
-      nFree += pcache1MemSize(p->page.pBuf);
+      if( p->pCache->szAlign ){
+        /* The slab is only freed once all of its buffers are unused */
+        nFree += p->pCache->szPage + sqlite3MallocSize(p);
+      }else{
+        nFree += pcache1MemSize(p->page.pBuf);
 #ifdef SQLITE_PCACHE_SEPARATE_HEADER
-      nFree += sqlite3MemSize(p);
+        nFree += sqlite3MemSize(p);
 #endif
+      }
       pcache1PinPage(p);
       pcache1RemoveFromHash(p);
       pcache1FreePage(p);
@@ -198,6 +198,8 @@ static int flagPragma(Parse *pParse, const char *zLeft, const char *zRight){
     ** flag if there are any active statements. */
     { "read_uncommitted",         SQLITE_ReadUncommitted },
     { "recursive_triggers",       SQLITE_RecTriggers },
+    { "sorted_index_insert",      SQLITE_SortIdxInsert },
+    { "lazy_schema",              SQLITE_LazySchema },
 
     /* This flag may only be set if both foreign-key and trigger support
     ** are present in the build.  */
@@ -634,6 +636,63 @@ void sqlite3Pragma(
     returnSingleInt(pParse, "journal_size_limit", iLimit);
   }else
 
+  /*
+  **  PRAGMA [database.]readahead
+  **  PRAGMA [database.]readahead=N
+  **
+  ** Get or set the maximum number of pages read ahead of a sequential
+  ** scan of the database file. Zero disables read-ahead.
+  */
+  if( sqlite3StrICmp(zLeft,"readahead")==0 ){
+    Pager *pPager = sqlite3BtreePager(pDb->pBt);
+    int nPage = -1;
+    if( zRight ){
+      nPage = sqlite3Atoi(zRight);
+      if( nPage<0 ) nPage = 0;
+    }
+    nPage = sqlite3PagerReadahead(pPager, nPage);
+    returnSingleInt(pParse, "readahead", nPage);
+  }else
+
+  /*
+  **  PRAGMA [database.]checkpoint_threads
+  **  PRAGMA [database.]checkpoint_threads=N
+  **
+  ** Get or set the number of worker threads that a checkpoint may use,
+  ** in addition to the thread that runs it, to write pages to the
+  ** database file. Zero means that all writes are done by the thread
+  ** running the checkpoint.
+  */
+  if( sqlite3StrICmp(zLeft,"checkpoint_threads")==0 ){
+    Pager *pPager = sqlite3BtreePager(pDb->pBt);
+    int nThread = -1;
+    if( zRight ){
+      nThread = sqlite3Atoi(zRight);
+      if( nThread<0 ) nThread = 0;
+    }
+    nThread = sqlite3PagerCheckpointThreads(pPager, nThread);
+    returnSingleInt(pParse, "checkpoint_threads", nThread);
+  }else
+
+  /*
+  **  PRAGMA [database.]journal_pipeline
+  **  PRAGMA [database.]journal_pipeline=BOOLEAN
+  **
+  ** Query or change the pipelined commit setting. When it is on, a
+  ** commit in PERSIST or TRUNCATE journal mode does one less sync of the
+  ** journal file and starts writing database pages back to disk before
+  ** the database file is synced.
+  */
+  if( sqlite3StrICmp(zLeft,"journal_pipeline")==0 ){
+    Pager *pPager = sqlite3BtreePager(pDb->pBt);
+    int b = -1;
+    if( zRight ){
+      b = sqlite3GetBoolean(zRight, 0);
+    }
+    b = sqlite3PagerJournalPipeline(pPager, b);
+    returnSingleInt(pParse, "journal_pipeline", b);
+  }else
+
 #endif /* SQLITE_OMIT_PAGER_PRAGMAS */
 
   /*
@@ -719,6 +778,50 @@ void sqlite3Pragma(
     sqlite3VdbeAddOp2(v, OP_IfPos, 1, addr);
     sqlite3VdbeJumpHere(v, addr);
   }else
+
+  /*
+  **  PRAGMA [database.]compact
+  **  PRAGMA [database.]compact(N)
+  **
+  ** Shrink the database file by up to N pages (or as far as possible if N
+  ** is omitted) by moving pages from the end of the file into free pages
+  ** nearer the start and then truncating the file. Unlike 
+  ** incremental_vacuum, this works whether or not the database is in
+  ** auto-vacuum mode.
+  */
+  if( sqlite3StrICmp(zLeft,"compact")==0 ){
+    int iLimit;
+    HashElem *x;
+    int cnt = 0;
+    if( sqlite3ReadSchema(pParse) ){
+      goto pragma_out;
+    }
+    if( zRight==0 || !sqlite3GetInt32(zRight, &iLimit) || iLimit<=0 ){
+      iLimit = 0x7fffffff;
+    }
+    sqlite3BeginWriteOperation(pParse, 0, iDb);
+
+    /* Load the root page numbers of every table and index into
+    ** registers 2, 3, ... for use by OP_Compact. */
+    assert( sqlite3SchemaMutexHeld(db, iDb, 0) );
+    sqlite3LazyLoadAll(db, iDb);
+    for(x=sqliteHashFirst(&pDb->pSchema->tblHash); x; x=sqliteHashNext(x)){
+      Table *pTab = sqliteHashData(x);
+      Index *pIdx;
+      sqlite3VdbeAddOp2(v, OP_Integer, pTab->tnum, 2+cnt);
+      cnt++;
+      for(pIdx=pTab->pIndex; pIdx; pIdx=pIdx->pNext){
+        sqlite3VdbeAddOp2(v, OP_Integer, pIdx->tnum, 2+cnt);
+        cnt++;
+      }
+    }
+    if( pParse->nMem < cnt+1 ){
+      pParse->nMem = cnt+1;
+    }
+    sqlite3VdbeAddOp2(v, OP_Integer, iLimit, 1);
+    sqlite3VdbeAddOp3(v, OP_Compact, 2, cnt, 1);
+    sqlite3VdbeChangeP5(v, (u8)iDb);
+  }else
 #endif
 
 #ifndef SQLITE_OMIT_PAGER_PRAGMAS
@@ -1380,6 +1483,7 @@ void sqlite3Pragma(
       ** for all tables and indices in the database.
       */
       assert( sqlite3SchemaMutexHeld(db, i, 0) );
+      sqlite3LazyLoadAll(db, i);
       pTbls = &db->aDb[i].pSchema->tblHash;
       for(x=sqliteHashFirst(pTbls); x; x=sqliteHashNext(x)){
         Table *pTab = sqliteHashData(x);
@@ -1661,6 +1765,57 @@ void sqlite3Pragma(
   }else
 #endif /* SQLITE_OMIT_COMPILEOPTION_DIAGS */
 
+#if SQLITE_THREADSAFE
+  /*
+  **   PRAGMA mutex_stats
+  **
+  ** Return one row for each of the static mutexes and for the mutex
+  ** belonging to this database connection. Each row contains the name of
+  ** the mutex, the number of times it has been entered and the number of
+  ** those times that the caller had to wait for another thread. The
+  ** counters are read when the statement is prepared. No rows are returned
+  ** if the mutex implementation in use does not keep these statistics.
+  */
+  if( sqlite3StrICmp(zLeft, "mutex_stats")==0 ){
+    static const struct {
+      const char *zName;          /* Name returned by the pragma */
+      int id;                     /* Mutex type */
+    } aMutex[] = {
+      { "master",    SQLITE_MUTEX_STATIC_MASTER },
+      { "mem",       SQLITE_MUTEX_STATIC_MEM    },
+      { "open",      SQLITE_MUTEX_STATIC_OPEN   },
+      { "prng",      SQLITE_MUTEX_STATIC_PRNG   },
+      { "lru",       SQLITE_MUTEX_STATIC_LRU    },
+      { "pmem",      SQLITE_MUTEX_STATIC_PMEM   },
+      { "db",        0                          },
+    };
+    int i;
+    sqlite3VdbeSetNumCols(v, 3);
+    pParse->nMem = 3;
+    sqlite3VdbeSetColName(v, 0, COLNAME_NAME, "mutex", SQLITE_STATIC);
+    sqlite3VdbeSetColName(v, 1, COLNAME_NAME, "enters", SQLITE_STATIC);
+    sqlite3VdbeSetColName(v, 2, COLNAME_NAME, "waits", SQLITE_STATIC);
+    for(i=0; i<ArraySize(aMutex); i++){
+      sqlite3_mutex *pMutex;
+      u32 aCnt[2];
+      int j;
+      if( aMutex[i].id ){
+        pMutex = sqlite3MutexAlloc(aMutex[i].id);
+      }else{
+        pMutex = db->mutex;
+      }
+      if( !sqlite3MutexStats(pMutex, &aCnt[0], &aCnt[1]) ) continue;
+      sqlite3VdbeAddOp4(v, OP_String8, 0, 1, 0, aMutex[i].zName, 0);
+      for(j=0; j<2; j++){
+        i64 *pI64 = sqlite3DbMallocRaw(db, sizeof(i64));
+        if( pI64 ) *pI64 = aCnt[j];
+        sqlite3VdbeAddOp4(v, OP_Int64, 0, j+2, 0, (char*)pI64, P4_INT64);
+      }
+      sqlite3VdbeAddOp2(v, OP_ResultRow, 1, 3);
+    }
+  }else
+#endif /* SQLITE_THREADSAFE */
+
 #ifndef SQLITE_OMIT_WAL
   /*
   **   PRAGMA [database.]wal_checkpoint = passive|full|restart
@@ -1732,6 +1887,24 @@ void sqlite3Pragma(
     returnSingleInt(pParse, "timeout",  db->busyTimeout);
   }else
 
+  /*
+  **   PRAGMA lookaside_growth
+  **   PRAGMA lookaside_growth = N
+  **
+  ** Get or set the maximum number of bytes of memory that the lookaside
+  ** allocator of the connection may obtain, in addition to its configured
+  ** buffers, for allocations of up to 1024 bytes. Zero disables this.
+  */
+  if( sqlite3StrICmp(zLeft, "lookaside_growth")==0 ){
+    int nByte = -1;
+    if( zRight ){
+      nByte = sqlite3Atoi(zRight);
+      if( nByte<0 ) nByte = 0;
+    }
+    returnSingleInt(pParse, "lookaside_growth",
+                    sqlite3LookasideGrowth(db, nByte));
+  }else
+
 #if defined(SQLITE_DEBUG) || defined(SQLITE_TEST)
   /*
   ** Report the current state of file logs for all databases
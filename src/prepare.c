@@ -123,6 +123,703 @@ int sqlite3InitCallback(void *pInit, int argc, char **argv, char **NotUsed){
   return 0;
 }
 
+/*
+** If the SQLITE_LazySchema flag is set when the schema of a database
+** other than TEMP is loaded, the CREATE statements read from its
+** sqlite_master table are not parsed right away. Instead, the rows for
+** each table, together with those for its indexes and triggers, are
+** stored in a LazyTable object found through Schema.lazyHash. They are
+** parsed by sqlite3LazyLoad() or sqlite3LazyLoadObject() when
+** sqlite3FindTable() or a similar routine first looks for the table or
+** one of its indexes or triggers.
+**
+** The stored rows remain valid for as long as the schema itself, as any
+** change to sqlite_master also changes the schema cookie. So nothing has
+** to be read from the database file when a table is parsed.
+**
+** The objects for some tables are always parsed right away: those that
+** may have foreign keys, so that sqlite3FkReferences() can find them from
+** the parent table, and the sqlite_sequence and sqlite_statN tables.
+**
+** All rows read from sqlite_master are kept in a LazyImage object, which
+** is never modified once it has been built. An image is shared by all
+** connections that read the same rows from the same database file, so
+** that the memory used to store a large schema is not multiplied by the
+** number of connections. When a schema is loaded and an image of the
+** same file with the same schema cookie already exists, the rows read
+** are compared with those of the existing image instead of being copied.
+** If they all match, the existing image is used. Each connection still
+** parses the tables it uses into its own Table, Index and Trigger objects.
+*/
+typedef struct LazyRow LazyRow;
+typedef struct LazyTable LazyTable;
+typedef struct LazyLoader LazyLoader;
+struct LazyRow {
+  char *zName;          /* Name of object, or of index for a stat row */
+  char *zSql;           /* CREATE statement, or stat column of a stat row */
+  int iRoot;            /* Root page number */
+  u8 isObj;             /* True for an index or trigger */
+  LazyTable *pTab;      /* Table this row belongs to */
+  LazyRow *pNext;       /* Next row for the same table */
+  LazyRow *pNextRow;    /* Next row of the image, in rowid order */
+};
+struct LazyTable {
+  char *zName;          /* Name of the table (tbl_name in sqlite_master) */
+  LazyRow *pFirst;      /* First sqlite_master row, in rowid order */
+  LazyRow *pLast;       /* Last sqlite_master row */
+  u8 bEager;            /* True to parse when the schema is loaded */
+  LazyTable *pNextTable;  /* Next table of the same image */
+};
+struct LazyImage {
+  char *zFile;          /* Database file, or NULL if the image is private */
+  int schema_cookie;    /* Schema cookie of the file the rows were read from */
+  int nRef;             /* Number of schemas using this image */
+  int nByte;            /* Heap memory used by this image */
+  LazyRow *pFirst;      /* First row, in rowid order */
+  LazyRow *pLast;       /* Last row */
+  LazyTable *pFirstTable; /* First table, in order of first row */
+  LazyTable *pLastTable;  /* Last table */
+  LazyImage *pNext;     /* Next shared image */
+};
+
+/*
+** An instance of the following structure is passed to lazyInitCallback()
+** while the rows of sqlite_master are read.
+*/
+struct LazyLoader {
+  InitData *pData;      /* Database and error information */
+  const char *zFile;    /* Database file, or NULL if not shared */
+  int schema_cookie;    /* Schema cookie of database file */
+  LazyImage *pImage;    /* Image being built, or NULL */
+  LazyImage *pShared;   /* Shared image that has matched so far, or NULL */
+  LazyRow *pNextShared; /* Next row of pShared to match */
+  Hash tblHash;         /* Tables of pImage by name */
+  Hash objHash;         /* Indexes and triggers of pImage by name */
+};
+
+/*
+** The list of images that may be shared between connections. The
+** SQLITE_MUTEX_STATIC_MASTER mutex must be held while accessing this
+** list or the LazyImage.nRef field of an image in it.
+*/
+static SQLITE_WSD LazyImage *lazyImageList = 0;
+#define wsdLazyImageList GLOBAL(LazyImage*, lazyImageList)
+
+/*
+** Free a list of rows linked by LazyRow.pNext.
+*/
+static void lazyRowFree(LazyRow *pRow){
+  while( pRow ){
+    LazyRow *pNext = pRow->pNext;
+    sqlite3_free(pRow);
+    pRow = pNext;
+  }
+}
+
+/*
+** Allocate a new LazyRow object with copies of strings zName and zSql,
+** either of which may be NULL.
+*/
+static LazyRow *lazyRowNew(const char *zName, const char *zSql){
+  int nName = zName ? sqlite3Strlen30(zName)+1 : 0;
+  int nSql = zSql ? sqlite3Strlen30(zSql)+1 : 0;
+  LazyRow *pRow = (LazyRow*)sqlite3MallocZero(sizeof(LazyRow) + nName + nSql);
+  if( pRow ){
+    char *z = (char*)&pRow[1];
+    if( zName ){
+      pRow->zName = z;
+      memcpy(z, zName, nName);
+      z += nName;
+    }
+    if( zSql ){
+      pRow->zSql = z;
+      memcpy(z, zSql, nSql);
+    }
+  }
+  return pRow;
+}
+
+/*
+** Free an image and all its rows and tables.
+*/
+static void lazyImageFree(LazyImage *pImage){
+  LazyRow *pRow, *pNextRow;
+  LazyTable *pLazy, *pNextTable;
+  for(pRow=pImage->pFirst; pRow; pRow=pNextRow){
+    pNextRow = pRow->pNextRow;
+    sqlite3_free(pRow);
+  }
+  for(pLazy=pImage->pFirstTable; pLazy; pLazy=pNextTable){
+    pNextTable = pLazy->pNextTable;
+    sqlite3_free(pLazy);
+  }
+  sqlite3_free(pImage);
+}
+
+/*
+** Drop a reference to an image. Free it if this is the last one.
+*/
+static void lazyImageRelease(LazyImage *pImage){
+  int nRef;
+  if( pImage==0 ) return;
+  if( pImage->zFile ){
+    sqlite3_mutex *mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MASTER);
+    sqlite3_mutex_enter(mutex);
+    nRef = --pImage->nRef;
+    if( nRef==0 ){
+      LazyImage **pp;
+      for(pp=&wsdLazyImageList; *pp!=pImage; pp=&(*pp)->pNext);
+      *pp = pImage->pNext;
+    }
+    sqlite3_mutex_leave(mutex);
+  }else{
+    nRef = --pImage->nRef;
+  }
+  if( nRef==0 ) lazyImageFree(pImage);
+}
+
+/*
+** Return true if CREATE statement zSql might declare a foreign key.
+*/
+static int lazyHasForeignKey(const char *zSql){
+  const char *z;
+  for(z=zSql; *z; z++){
+    if( (*z=='r' || *z=='R') && sqlite3_strnicmp(z, "references", 10)==0 ){
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+** Add a row read from sqlite_master to the image being built by loader p,
+** allocating the image if this is the first row. Return SQLITE_OK if
+** successful or SQLITE_NOMEM if a malloc fails.
+*/
+static int lazyAddRow(
+  LazyLoader *p,        /* Loader to add the row to */
+  const char *zName,    /* Value of the "name" column */
+  int iRoot,            /* Value of the "rootpage" column */
+  const char *zSql,     /* Value of the "sql" column, or NULL */
+  int isObj,            /* True if "type" is "index" or "trigger" */
+  const char *zTab      /* Value of the "tbl_name" column */
+){
+  LazyImage *pImage = p->pImage;
+  LazyTable *pLazy;
+  LazyRow *pRow;
+  int nName;
+
+  if( pImage==0 ){
+    int nFile = p->zFile ? sqlite3Strlen30(p->zFile)+1 : 0;
+    pImage = (LazyImage*)sqlite3MallocZero(sizeof(LazyImage) + nFile);
+    if( pImage==0 ) return SQLITE_NOMEM;
+    if( p->zFile ){
+      pImage->zFile = (char*)&pImage[1];
+      memcpy(pImage->zFile, p->zFile, nFile);
+    }
+    pImage->schema_cookie = p->schema_cookie;
+    pImage->nRef = 1;
+    pImage->nByte = sqlite3MallocSize(pImage);
+    p->pImage = pImage;
+  }
+
+  nName = sqlite3Strlen30(zTab);
+  pLazy = (LazyTable*)sqlite3HashFind(&p->tblHash, zTab, nName);
+  if( pLazy==0 ){
+    pLazy = (LazyTable*)sqlite3MallocZero(sizeof(LazyTable) + nName + 1);
+    if( pLazy==0 ) return SQLITE_NOMEM;
+    pLazy->zName = (char*)&pLazy[1];
+    memcpy(pLazy->zName, zTab, nName+1);
+    if( pImage->pLastTable ){
+      pImage->pLastTable->pNextTable = pLazy;
+    }else{
+      pImage->pFirstTable = pLazy;
+    }
+    pImage->pLastTable = pLazy;
+    pImage->nByte += sqlite3MallocSize(pLazy);
+    if( sqlite3HashInsert(&p->tblHash, pLazy->zName, nName, pLazy) ){
+      return SQLITE_NOMEM;
+    }
+    if( sqlite3_strnicmp(pLazy->zName, "sqlite_", 7)==0 ) pLazy->bEager = 1;
+  }
+
+  pRow = lazyRowNew(zName, zSql);
+  if( pRow==0 ) return SQLITE_NOMEM;
+  pRow->iRoot = iRoot;
+  pRow->isObj = (u8)isObj;
+  pRow->pTab = pLazy;
+  if( pLazy->pLast ){
+    pLazy->pLast->pNext = pRow;
+  }else{
+    pLazy->pFirst = pRow;
+  }
+  pLazy->pLast = pRow;
+  if( pImage->pLast ){
+    pImage->pLast->pNextRow = pRow;
+  }else{
+    pImage->pFirst = pRow;
+  }
+  pImage->pLast = pRow;
+  pImage->nByte += sqlite3MallocSize(pRow);
+
+  if( isObj ){
+    /* If another table has an index or trigger of the same name, the
+    ** name cannot be used to find either, so parse both right away. */
+    LazyTable *pOther;
+    nName = sqlite3Strlen30(pRow->zName);
+    pOther = sqlite3HashFind(&p->objHash, pRow->zName, nName);
+    if( pOther==0 ){
+      if( sqlite3HashInsert(&p->objHash, pRow->zName, nName, pLazy) ){
+        return SQLITE_NOMEM;
+      }
+    }else if( pOther!=pLazy ){
+      pOther->bEager = 1;
+      pLazy->bEager = 1;
+    }
+  }else if( pRow->zSql && lazyHasForeignKey(pRow->zSql) ){
+    pLazy->bEager = 1;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Stop comparing rows with those of the shared image p->pShared. Copy
+** the rows of the shared image that have matched so far into the image
+** being built instead. Return SQLITE_OK or SQLITE_NOMEM.
+*/
+static int lazyUnshare(LazyLoader *p){
+  LazyRow *pRow;
+  int rc = SQLITE_OK;
+  for(pRow=p->pShared->pFirst; rc==SQLITE_OK && pRow!=p->pNextShared;
+      pRow=pRow->pNextRow){
+    rc = lazyAddRow(p, pRow->zName, pRow->iRoot, pRow->zSql, pRow->isObj,
+                    pRow->pTab->zName);
+  }
+  lazyImageRelease(p->pShared);
+  p->pShared = 0;
+  p->pNextShared = 0;
+  return rc;
+}
+
+/*
+** Return true if the values of sqlite_master row argv[] are the same as
+** those stored in pRow.
+*/
+static int lazyRowMatch(LazyRow *pRow, int iRoot, int isObj, char **argv){
+  return pRow->iRoot==iRoot
+      && pRow->isObj==isObj
+      && strcmp(pRow->zName, argv[0])==0
+      && strcmp(pRow->pTab->zName, argv[4])==0
+      && (pRow->zSql==0 ? argv[2]==0 : argv[2] && !strcmp(pRow->zSql,argv[2]));
+}
+
+/*
+** This callback is used instead of sqlite3InitCallback() to read the
+** schema of a database when the SQLITE_LazySchema flag is set. It either
+** checks that the row matches the next row of the shared image being
+** compared, or adds it to the image being built.
+**
+**     argv[0] = name of thing being created
+**     argv[1] = root page number for table or index. 0 for trigger or view.
+**     argv[2] = SQL text for the CREATE statement.
+**     argv[3] = type of thing being created
+**     argv[4] = name of the table it belongs to
+*/
+static int lazyInitCallback(void *pArg, int argc, char **argv, char **NotUsed){
+  LazyLoader *p = (LazyLoader*)pArg;
+  InitData *pData = p->pData;
+  sqlite3 *db = pData->db;
+  int iRoot;
+  int isObj;
+
+  assert( argc==5 );
+  UNUSED_PARAMETER2(NotUsed, argc);
+  if( argv==0 ) return 0;   /* Might happen if EMPTY_RESULT_CALLBACKS are on */
+  if( db->mallocFailed
+   || argv[0]==0 || argv[1]==0 || argv[3]==0 || argv[4]==0
+  ){
+    /* Let sqlite3InitCallback() report the error. */
+    return sqlite3InitCallback(pData, 3, argv, 0);
+  }
+  DbClearProperty(db, pData->iDb, DB_Empty);
+
+  iRoot = sqlite3Atoi(argv[1]);
+  isObj = sqlite3_stricmp(argv[3], "index")==0
+       || sqlite3_stricmp(argv[3], "trigger")==0;
+  if( p->pShared ){
+    LazyRow *pRow = p->pNextShared;
+    if( pRow && lazyRowMatch(pRow, iRoot, isObj, argv) ){
+      p->pNextShared = pRow->pNextRow;
+      return 0;
+    }
+    if( lazyUnshare(p) ) goto no_mem;
+  }
+  if( lazyAddRow(p, argv[0], iRoot, argv[2], isObj, argv[4]) ) goto no_mem;
+  return 0;
+
+no_mem:
+  db->mallocFailed = 1;
+  pData->rc = SQLITE_NOMEM;
+  return 1;
+}
+
+/*
+** Initialize a loader used to read the schema of database iDb, the
+** schema cookie of which is iCookie. If a matching shared image exists,
+** take a reference to it so that it can be compared with the rows read.
+*/
+static void lazyLoaderInit(
+  LazyLoader *p,
+  InitData *pData,
+  int iCookie
+){
+  sqlite3 *db = pData->db;
+  const char *zFile = sqlite3BtreeGetFilename(db->aDb[pData->iDb].pBt);
+
+  memset(p, 0, sizeof(*p));
+  p->pData = pData;
+  p->schema_cookie = iCookie;
+  sqlite3HashInit(&p->tblHash);
+  sqlite3HashInit(&p->objHash);
+  if( zFile && zFile[0] ){
+    sqlite3_mutex *mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MASTER);
+    LazyImage *pImage;
+    p->zFile = zFile;
+    sqlite3_mutex_enter(mutex);
+    for(pImage=wsdLazyImageList; pImage; pImage=pImage->pNext){
+      if( pImage->schema_cookie==iCookie && strcmp(pImage->zFile, zFile)==0 ){
+        pImage->nRef++;
+        p->pShared = pImage;
+        p->pNextShared = pImage->pFirst;
+        break;
+      }
+    }
+    sqlite3_mutex_leave(mutex);
+  }
+}
+
+/*
+** Finish reading the schema with loader p and return the image holding
+** the rows read, or NULL if there were none. A new image is added to the
+** list of shared images, unless rc indicates that an error occurred
+** while reading the rows. If a malloc has failed, free everything and
+** return NULL.
+*/
+static LazyImage *lazyLoaderFinish(LazyLoader *p, int rc){
+  LazyImage *pRet = 0;
+  if( rc==SQLITE_OK && p->pShared && p->pNextShared ){
+    /* Fewer rows were read than are stored in the shared image */
+    rc = lazyUnshare(p);
+  }
+  sqlite3HashClear(&p->tblHash);
+  sqlite3HashClear(&p->objHash);
+  if( rc==SQLITE_NOMEM || p->pData->db->mallocFailed ){
+    lazyImageRelease(p->pShared);
+    if( p->pImage ) lazyImageFree(p->pImage);
+    p->pData->db->mallocFailed = 1;
+  }else if( p->pShared ){
+    pRet = p->pShared;
+  }else if( (pRet = p->pImage)!=0 && pRet->zFile ){
+    if( rc==SQLITE_OK ){
+      sqlite3_mutex *mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MASTER);
+      sqlite3_mutex_enter(mutex);
+      pRet->pNext = wsdLazyImageList;
+      wsdLazyImageList = pRet;
+      sqlite3_mutex_leave(mutex);
+    }else{
+      pRet->zFile = 0;
+    }
+  }
+  return pRet;
+}
+
+/*
+** Parse the stored rows of LazyTable pLazy, which belongs to database iDb,
+** into the schema, using sqlite3InitCallback(). Errors are left in pData.
+** pLazy is removed from the tables of the schema waiting to be parsed.
+*/
+static void lazyParse(sqlite3 *db, int iDb, LazyTable *pLazy, InitData *pData){
+  Schema *pSchema = db->aDb[iDb].pSchema;
+  struct sqlite3InitInfo saved = db->init;
+  int commit_internal = !(db->flags&SQLITE_InternChanges);
+  int nName = sqlite3Strlen30(pLazy->zName);
+  LazyRow *pRow;
+  LazyRow *pStat;
+
+  assert( sqlite3SchemaMutexHeld(db, iDb, 0) );
+  sqlite3HashInsert(&pSchema->lazyHash, pLazy->zName, nName, 0);
+  for(pRow=pLazy->pFirst; pRow; pRow=pRow->pNext){
+    int n;
+    if( pRow->isObj==0 ) continue;
+    n = sqlite3Strlen30(pRow->zName);
+    if( sqlite3HashFind(&pSchema->lazyObjHash, pRow->zName, n)==pLazy ){
+      sqlite3HashInsert(&pSchema->lazyObjHash, pRow->zName, n, 0);
+    }
+  }
+  pStat = (LazyRow*)sqlite3HashFind(&pSchema->lazyStatHash,pLazy->zName,nName);
+  if( pStat ){
+    sqlite3HashInsert(&pSchema->lazyStatHash, pLazy->zName, nName, 0);
+  }
+
+  db->init.busy = 1;
+  for(pRow=pLazy->pFirst; pRow && pData->rc==SQLITE_OK; pRow=pRow->pNext){
+    char zRoot[16];
+    char *azArg[3];
+    sqlite3_snprintf(sizeof(zRoot), zRoot, "%d", pRow->iRoot);
+    azArg[0] = pRow->zName;
+    azArg[1] = zRoot;
+    azArg[2] = pRow->zSql;
+    sqlite3InitCallback(pData, 3, azArg, 0);
+  }
+#ifndef SQLITE_OMIT_ANALYZE
+  for(pRow=pStat; pRow && pData->rc==SQLITE_OK; pRow=pRow->pNext){
+    char *azArg[3];
+    azArg[0] = pLazy->zName;
+    azArg[1] = pRow->zName;
+    azArg[2] = pRow->zSql;
+    sqlite3AnalysisLoadRow(db, iDb, azArg);
+  }
+#endif
+  lazyRowFree(pStat);
+  db->init = saved;
+  if( commit_internal ){
+    sqlite3CommitInternalChanges(db);
+  }
+}
+
+/*
+** Parse the stored rows of LazyTable pLazy outside of sqlite3Init().
+** If an error occurs, the objects that could not be parsed are left out
+** of the schema and the error is written to the log.
+*/
+static void lazyParseOne(sqlite3 *db, int iDb, LazyTable *pLazy){
+  InitData initData;
+  char *zErr = 0;
+#ifndef SQLITE_OMIT_AUTHORIZATION
+  int (*xAuth)(void*,int,const char*,const char*,const char*,const char*);
+  xAuth = db->xAuth;
+  db->xAuth = 0;
+#endif
+  initData.db = db;
+  initData.iDb = iDb;
+  initData.rc = SQLITE_OK;
+  initData.pzErrMsg = &zErr;
+  lazyParse(db, iDb, pLazy, &initData);
+#ifndef SQLITE_OMIT_AUTHORIZATION
+  db->xAuth = xAuth;
+#endif
+  if( initData.rc==SQLITE_NOMEM || db->mallocFailed ){
+    /* Some of the objects may be missing from the schema. Change the cached
+    ** schema cookie so that OP_VerifyCookie discards the schema and it is
+    ** reloaded before it is used again. */
+    db->aDb[iDb].pSchema->schema_cookie--;
+  }else if( initData.rc!=SQLITE_OK ){
+    sqlite3_log(initData.rc, "%s", zErr ? zErr : "error parsing schema");
+  }
+  sqlite3DbFree(db, zErr);
+}
+
+/*
+** Unless there is already an entry for zName in hash table pHash, add
+** one with data pData. Return SQLITE_OK or SQLITE_NOMEM.
+*/
+static int lazyHashAdd(Hash *pHash, const char *zName, void *pData){
+  int nName = sqlite3Strlen30(zName);
+  if( sqlite3HashFind(pHash, zName, nName)==0
+   && sqlite3HashInsert(pHash, zName, nName, pData)
+  ){
+    return SQLITE_NOMEM;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Use image pImage, which holds the sqlite_master rows of database iDb,
+** for the schema of iDb. The reference to pImage is passed to the schema.
+** Tables that cannot wait are parsed right away. Errors are left in pData.
+*/
+static void lazyAttach(
+  sqlite3 *db,
+  int iDb,
+  LazyImage *pImage,
+  InitData *pData
+){
+  Schema *pSchema = db->aDb[iDb].pSchema;
+  LazyTable *pLazy;
+
+  assert( pSchema->pLazyImage==0 );
+  pSchema->pLazyImage = pImage;
+  for(pLazy=pImage->pFirstTable; pLazy; pLazy=pLazy->pNextTable){
+    LazyRow *pRow;
+    int rc;
+    if( pLazy->bEager ) continue;
+    rc = lazyHashAdd(&pSchema->lazyHash, pLazy->zName, pLazy);
+    for(pRow=pLazy->pFirst; rc==SQLITE_OK && pRow; pRow=pRow->pNext){
+      if( pRow->isObj ){
+        rc = lazyHashAdd(&pSchema->lazyObjHash, pRow->zName, pLazy);
+      }
+    }
+    if( rc ){
+      db->mallocFailed = 1;
+      pData->rc = SQLITE_NOMEM;
+      return;
+    }
+  }
+  for(pLazy=pImage->pFirstTable; pLazy; pLazy=pLazy->pNextTable){
+    if( pLazy->bEager && pData->rc==SQLITE_OK ){
+      lazyParse(db, iDb, pLazy, pData);
+    }
+  }
+}
+
+/*
+** If table zName of database iDb has not been parsed yet, parse it along
+** with its indexes and triggers. Return non-zero if anything was parsed.
+*/
+int sqlite3LazyLoad(sqlite3 *db, int iDb, const char *zName){
+  Schema *pSchema = db->aDb[iDb].pSchema;
+  LazyTable *pLazy;
+  if( pSchema->lazyHash.count==0 || db->mallocFailed ) return 0;
+  pLazy = sqlite3HashFind(&pSchema->lazyHash, zName, sqlite3Strlen30(zName));
+  if( pLazy==0 ) return 0;
+  lazyParseOne(db, iDb, pLazy);
+  return 1;
+}
+
+/*
+** If index or trigger zName of database iDb has not been parsed yet, parse
+** it along with its table. Return non-zero if anything was parsed.
+*/
+int sqlite3LazyLoadObject(sqlite3 *db, int iDb, const char *zName){
+  Schema *pSchema = db->aDb[iDb].pSchema;
+  LazyTable *pLazy;
+  if( pSchema->lazyObjHash.count==0 || db->mallocFailed ) return 0;
+  pLazy = sqlite3HashFind(&pSchema->lazyObjHash, zName,sqlite3Strlen30(zName));
+  if( pLazy==0 ) return 0;
+  lazyParseOne(db, iDb, pLazy);
+  return 1;
+}
+
+/*
+** Parse all objects of database iDb that have not been parsed yet. This
+** is required before iterating through the tables of a schema.
+*/
+void sqlite3LazyLoadAll(sqlite3 *db, int iDb){
+  Schema *pSchema = db->aDb[iDb].pSchema;
+  HashElem *p;
+  while( !db->mallocFailed && (p = sqliteHashFirst(&pSchema->lazyHash))!=0 ){
+    lazyParseOne(db, iDb, (LazyTable*)sqliteHashData(p));
+  }
+}
+
+/*
+** Forget the tables of schema pSchema that have not been parsed yet and
+** release its image.
+*/
+void sqlite3LazyClear(Schema *pSchema){
+  HashElem *p;
+  sqlite3HashClear(&pSchema->lazyHash);
+  sqlite3HashClear(&pSchema->lazyObjHash);
+  for(p=sqliteHashFirst(&pSchema->lazyStatHash); p; p=sqliteHashNext(p)){
+    lazyRowFree((LazyRow*)sqliteHashData(p));
+  }
+  sqlite3HashClear(&pSchema->lazyStatHash);
+  lazyImageRelease(pSchema->pLazyImage);
+  pSchema->pLazyImage = 0;
+}
+
+/*
+** The root page of a table or index of database iDb is about to move
+** from iFrom to another page. As the image may be shared, the stored row
+** is not modified. Instead, the table it belongs to is parsed now, so
+** that sqlite3RootPageMoved() can update the Table or Index object.
+*/
+void sqlite3LazyRootPageMoved(sqlite3 *db, int iDb, int iFrom){
+  HashElem *p;
+  for(p=sqliteHashFirst(&db->aDb[iDb].pSchema->lazyHash); p;
+      p=sqliteHashNext(p)){
+    LazyTable *pLazy = (LazyTable*)sqliteHashData(p);
+    LazyRow *pRow;
+    for(pRow=pLazy->pFirst; pRow; pRow=pRow->pNext){
+      if( pRow->iRoot==iFrom ){
+        lazyParseOne(db, iDb, pLazy);
+        return;
+      }
+    }
+  }
+}
+
+/*
+** Return the number of bytes of heap memory used to store the tables of
+** schema pSchema that have not been parsed yet. The memory used by an
+** image is divided between the schemas that share it.
+*/
+int sqlite3LazySize(Schema *pSchema){
+  LazyImage *pImage = pSchema->pLazyImage;
+  int nByte = 0;
+  HashElem *p;
+  nByte += sqlite3GlobalConfig.m.xRoundup(sizeof(HashElem)) * (
+      pSchema->lazyHash.count + pSchema->lazyObjHash.count
+    + pSchema->lazyStatHash.count
+  );
+  nByte += sqlite3MallocSize(pSchema->lazyHash.ht);
+  nByte += sqlite3MallocSize(pSchema->lazyObjHash.ht);
+  nByte += sqlite3MallocSize(pSchema->lazyStatHash.ht);
+  for(p=sqliteHashFirst(&pSchema->lazyStatHash); p; p=sqliteHashNext(p)){
+    LazyRow *pRow;
+    for(pRow=(LazyRow*)sqliteHashData(p); pRow; pRow=pRow->pNext){
+      nByte += sqlite3MallocSize(pRow);
+    }
+  }
+  if( pImage ){
+    sqlite3_mutex *mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MASTER);
+    sqlite3_mutex_enter(mutex);
+    nByte += pImage->nByte / pImage->nRef;
+    sqlite3_mutex_leave(mutex);
+  }
+  return nByte;
+}
+
+/*
+** This is called for each row of the sqlite_stat1 table of database iDb
+** as it is loaded, with argv[] set to the tbl, idx and stat columns. If
+** argv==0, discard all rows stored so far instead.
+**
+** If the table has not been parsed yet, store the row so that it can be
+** applied once it is, and return non-zero. Otherwise return zero.
+*/
+int sqlite3LazyStat(sqlite3 *db, int iDb, char **argv){
+  Schema *pSchema = db->aDb[iDb].pSchema;
+  LazyTable *pLazy;
+  LazyRow *pRow;
+  int nName;
+  if( argv==0 ){
+    HashElem *p;
+    for(p=sqliteHashFirst(&pSchema->lazyStatHash); p; p=sqliteHashNext(p)){
+      lazyRowFree((LazyRow*)sqliteHashData(p));
+    }
+    sqlite3HashClear(&pSchema->lazyStatHash);
+    return 0;
+  }
+  if( pSchema->lazyHash.count==0 ) return 0;
+  nName = sqlite3Strlen30(argv[0]);
+  pLazy = sqlite3HashFind(&pSchema->lazyHash, argv[0], nName);
+  if( pLazy==0 ) return 0;
+  pRow = lazyRowNew(argv[1], argv[2]);
+  if( pRow==0 ){
+    db->mallocFailed = 1;
+  }else{
+    pRow->pNext = sqlite3HashFind(&pSchema->lazyStatHash, pLazy->zName, nName);
+    if( sqlite3HashInsert(&pSchema->lazyStatHash, pLazy->zName, nName, pRow)
+        ==(void*)pRow
+    ){
+      sqlite3_free(pRow);
+      db->mallocFailed = 1;
+    }
+  }
+  return 1;
+}
+
 /*
 ** Attempt to read the database schema and initialize internal
 ** data structures for a single database file.  The index of the
@@ -323,16 +1020,29 @@ static int sqlite3InitOne(sqlite3 *db, int iDb, char **pzErrMsg){
   assert( db->init.busy );
   {
     char *zSql;
+    int bLazy = (iDb!=1 && (db->flags & SQLITE_LazySchema)!=0);
     zSql = sqlite3MPrintf(db, 
-        "SELECT name, rootpage, sql FROM '%q'.%s ORDER BY rowid",
-        db->aDb[iDb].zName, zMasterName);
+        "SELECT name, rootpage, sql%s FROM '%q'.%s ORDER BY rowid",
+        bLazy ? ", type, tbl_name" : "", db->aDb[iDb].zName, zMasterName);
 #ifndef SQLITE_OMIT_AUTHORIZATION
     {
       int (*xAuth)(void*,int,const char*,const char*,const char*,const char*);
       xAuth = db->xAuth;
       db->xAuth = 0;
 #endif
-      rc = sqlite3_exec(db, zSql, sqlite3InitCallback, &initData, 0);
+      if( bLazy ){
+        LazyLoader loader;
+        LazyImage *pImage;
+        lazyLoaderInit(&loader, &initData, pDb->pSchema->schema_cookie);
+        rc = sqlite3_exec(db, zSql, lazyInitCallback, &loader, 0);
+        if( rc==SQLITE_OK ) rc = initData.rc;
+        pImage = lazyLoaderFinish(&loader, rc);
+        if( pImage ){
+          lazyAttach(db, iDb, pImage, &initData);
+        }
+      }else{
+        rc = sqlite3_exec(db, zSql, sqlite3InitCallback, &initData, 0);
+      }
 #ifndef SQLITE_OMIT_AUTHORIZATION
       db->xAuth = xAuth;
     }
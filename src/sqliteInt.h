@@ -584,6 +584,19 @@ extern const int sqlite3one;
 # define SQLITE_DEFAULT_MMAP_SIZE SQLITE_MAX_MMAP_SIZE
 #endif
 
+/*
+** The maximum number of worker threads that a single checkpoint may use
+** in addition to the thread that runs it. Worker threads are never used
+** if SQLite is not threadsafe.
+*/
+#if SQLITE_THREADSAFE==0
+# undef SQLITE_MAX_WORKER_THREADS
+# define SQLITE_MAX_WORKER_THREADS 0
+#endif
+#ifndef SQLITE_MAX_WORKER_THREADS
+# define SQLITE_MAX_WORKER_THREADS 8
+#endif
+
 /*
 ** An instance of the following structure is used to store the busy-handler
 ** callback for a given sqlite handle. 
@@ -598,6 +611,8 @@ struct BusyHandler {
   int (*xFunc)(void *,int);  /* The busy callback */
   void *pArg;                /* First arg to busy callback */
   int nBusy;                 /* Incremented with each busy call */
+  sqlite3_file *pFile;       /* File that could not be locked, if known */
+  i64 iStart;                /* Start time of VFS waits, or 0 */
 };
 
 /*
@@ -707,8 +722,12 @@ typedef struct Index Index;
 typedef struct IndexSample IndexSample;
 typedef struct KeyClass KeyClass;
 typedef struct KeyInfo KeyInfo;
+typedef struct LazyImage LazyImage;
 typedef struct Lookaside Lookaside;
+typedef struct LookasideClass LookasideClass;
 typedef struct LookasideSlot LookasideSlot;
+typedef struct ParseArena ParseArena;
+typedef struct ArenaChunk ArenaChunk;
 typedef struct Module Module;
 typedef struct NameContext NameContext;
 typedef struct Parse Parse;
@@ -716,6 +735,7 @@ typedef struct RowSet RowSet;
 typedef struct Savepoint Savepoint;
 typedef struct Select Select;
 typedef struct SelectDest SelectDest;
+typedef struct SQLiteThread SQLiteThread;
 typedef struct SrcList SrcList;
 typedef struct StrAccum StrAccum;
 typedef struct Table Table;
@@ -785,6 +805,10 @@ struct Schema {
   Hash idxHash;        /* All (named) indices indexed by name */
   Hash trigHash;       /* All triggers indexed by name */
   Hash fkeyHash;       /* All foreign keys by referenced table name */
+  Hash lazyHash;       /* Tables not yet parsed (lazy_schema), by name */
+  Hash lazyObjHash;    /* Indexes and triggers of lazyHash tables, by name */
+  Hash lazyStatHash;   /* sqlite_stat1 rows for lazyHash tables, by table */
+  LazyImage *pLazyImage;  /* sqlite_master rows read for lazy_schema */
   Table *pSeqTab;      /* The sqlite_sequence table used by AUTOINCREMENT */
   u8 file_format;      /* Schema format version for this file */
   u8 enc;              /* Text encoding used by this database */
@@ -840,7 +864,38 @@ struct Schema {
 ** is shared by multiple database connections.  Therefore, while parsing
 ** schema information, the Lookaside.bEnabled flag is cleared so that
 ** lookaside allocations are not used to construct the schema objects.
+**
+** Requests that are too large for the configured buffers, or that are
+** made while all of them are checked out, are served from the lookaside
+** size classes of LOOKASIDE_CLASS_MIN, 2*LOOKASIDE_CLASS_MIN and so on
+** bytes, if the class is larger than Lookaside.sz. The slots of a size
+** class are carved out of chunks of LOOKASIDE_CHUNK_SZ bytes obtained
+** from sqlite3Malloc() as they are needed, up to a limit of mxChunk
+** chunks for the connection. Chunks are freed when the lookaside buffers
+** are reconfigured or the connection is closed, and by
+** sqlite3_db_release_memory() if no size class slots are checked out.
 */
+#define LOOKASIDE_NCLASS        3
+#define LOOKASIDE_CLASS_MIN   256
+#define LOOKASIDE_CHUNK_SZ  16384
+#define LOOKASIDE_MAX_CHUNK    16
+
+/*
+** The default limit, in bytes, on the memory used by the chunks of the
+** lookaside size classes of each database connection. It may be changed
+** using "PRAGMA lookaside_growth". The default is zero, so that the size
+** classes are not used and a connection uses no more memory than the
+** configured lookaside buffers unless the application asks for it.
+*/
+#ifndef SQLITE_DEFAULT_LOOKASIDE_GROWTH
+# define SQLITE_DEFAULT_LOOKASIDE_GROWTH 0
+#endif
+
+struct LookasideClass {
+  u16 sz;                 /* Size of each slot, or 0 if class not in use */
+  LookasideSlot *pFree;   /* List of available slots */
+  int anStat[2];          /* 0: hits.  1: misses due to the chunk limit */
+};
 struct Lookaside {
   u16 sz;                 /* Size of each buffer in bytes */
   u8 bEnabled;            /* False to disable new lookaside allocations */
@@ -851,11 +906,37 @@ struct Lookaside {
   LookasideSlot *pFree;   /* List of available buffers */
   void *pStart;           /* First byte of available memory space */
   void *pEnd;             /* First byte past end of available space */
+  int nChunkOut;          /* Number of size class slots checked out */
+  int nChunk;             /* Number of chunks in apChunk[] */
+  int mxChunk;            /* Maximum number of chunks */
+  void *pChunkLo;         /* Lowest address of any chunk */
+  void *pChunkHi;         /* First byte past the highest chunk */
+  u8 *apChunk[LOOKASIDE_MAX_CHUNK];    /* Chunks allocated for size classes */
+  u8 aChunkClass[LOOKASIDE_MAX_CHUNK]; /* Index in aClass[] of each chunk */
+  LookasideClass aClass[LOOKASIDE_NCLASS];  /* The size classes */
 };
 struct LookasideSlot {
   LookasideSlot *pNext;    /* Next buffer in the list of free buffers */
 };
 
+/*
+** While sqlite3RunParser() is running, the Expr, ExprList and Select
+** objects that make up the parse tree are allocated from the parse
+** arena, a list of chunks of memory owned by the database connection.
+** Allocation is by incrementing an offset into the most recent chunk.
+** Freeing an object is a no-op. Instead, all chunks used by the parse are
+** released at once when sqlite3RunParser() returns.
+**
+** Objects stored in the schema must outlive the parse. They are always
+** built while the Lookaside.bEnabled flag is clear, so the arena is only
+** used while it is set. Parse tree objects do not outlive the parse in
+** any other way.
+*/
+struct ParseArena {
+  int nDepth;             /* Number of active sqlite3RunParser() calls */
+  ArenaChunk *pChunk;     /* Most recently allocated chunk, or NULL */
+};
+
 /*
 ** A hash table for function definitions.
 **
@@ -884,6 +965,7 @@ struct sqlite3 {
   int errMask;                  /* & result codes with this before returning */
   u16 dbOptFlags;               /* Flags to enable/disable optimizations */
   u8 autoCommit;                /* The auto-commit flag. */
+  u8 bConcurrent;               /* Transaction opened by BEGIN CONCURRENT */
   u8 temp_store;                /* 1: file 2: memory 0: default */
   u8 mallocFailed;              /* True if we have seen a malloc failure */
   u8 dfltLockMode;              /* Default locking-mode for attached dbs */
@@ -932,6 +1014,7 @@ struct sqlite3 {
     double notUsed1;            /* Spacer */
   } u1;
   Lookaside lookaside;          /* Lookaside malloc configuration */
+  ParseArena arena;             /* Memory for parse tree objects */
 #ifndef SQLITE_OMIT_AUTHORIZATION
   int (*xAuth)(void*,int,const char*,const char*,const char*,const char*);
                                 /* Access authorization function */
@@ -1013,6 +1096,8 @@ struct sqlite3 {
 #define SQLITE_PreferBuiltin  0x00100000  /* Preference to built-in funcs */
 #define SQLITE_LoadExtension  0x00200000  /* Enable load_extension */
 #define SQLITE_EnableTrigger  0x00400000  /* True to enable triggers */
+#define SQLITE_SortIdxInsert  0x00800000  /* Sort index keys of INSERT SELECT */
+#define SQLITE_LazySchema     0x01000000  /* Parse schema objects when used */
 
 /*
 ** Bits of the sqlite3.dbOptFlags field that are used by the
@@ -2292,6 +2377,7 @@ struct Parse {
   u8 iColCache;        /* Next entry in aColCache[] to replace */
   u8 isMultiWrite;     /* True if statement may modify/insert multiple rows */
   u8 mayAbort;         /* True if statement may throw an ABORT exception */
+  u8 needStmtJournal;  /* True if a statement journal is always required */
   int aTempReg[8];     /* Holding area for temporary registers */
   int nRangeReg;       /* Size of the temporary register block */
   int iRangeReg;       /* First register in temporary register block */
@@ -2543,6 +2629,7 @@ struct Sqlite3Config {
   int bFullMutex;                   /* True to enable full mutexing */
   int bOpenUri;                     /* True to interpret filenames as URIs */
   int bUseCis;                      /* Use covering indices for full-scans */
+  int bMemThreadsafe;               /* True if m need not be serialized */
   int mxStrlen;                     /* Maximum string length */
   int szLookaside;                  /* Default lookaside buffer size */
   int nLookaside;                   /* Default lookaside buffer count */
@@ -2695,6 +2782,13 @@ char *sqlite3DbStrDup(sqlite3*,const char*);
 char *sqlite3DbStrNDup(sqlite3*,const char*, int);
 void *sqlite3Realloc(void*, int);
 void *sqlite3DbReallocOrFree(sqlite3 *, void *, int);
+void *sqlite3ArenaMallocRaw(sqlite3*, int);
+void *sqlite3ArenaMallocZero(sqlite3*, int);
+ArenaChunk *sqlite3ArenaBegin(sqlite3*);
+void sqlite3ArenaEnd(sqlite3*, ArenaChunk*);
+void sqlite3ArenaClose(sqlite3*);
+void sqlite3LookasideFreeChunks(sqlite3*);
+int sqlite3LookasideGrowth(sqlite3*, int);
 void *sqlite3DbRealloc(sqlite3 *, void *, int);
 void sqlite3DbFree(sqlite3*, void*);
 int sqlite3MallocSize(void*);
@@ -2740,7 +2834,30 @@ const sqlite3_mem_methods *sqlite3MemGetMemsys5(void);
   int sqlite3MutexInit(void);
   int sqlite3MutexEnd(void);
 #endif
+#ifdef SQLITE_MUTEX_PTHREADS
+  void sqlite3MutexEnterShared(sqlite3_mutex*);
+  void sqlite3MutexLeaveShared(sqlite3_mutex*);
+  int sqlite3MutexStats(sqlite3_mutex*, u32*, u32*);
+#else
+# define sqlite3MutexEnterShared(X) sqlite3_mutex_enter(X)
+# define sqlite3MutexLeaveShared(X) sqlite3_mutex_leave(X)
+# define sqlite3MutexStats(X,Y,Z)   0
+#endif
+
+#if SQLITE_MAX_WORKER_THREADS>0
+  int sqlite3ThreadCreate(SQLiteThread**, void*(*)(void*), void*);
+  int sqlite3ThreadJoin(SQLiteThread*, void**);
+#endif
 
+/*
+** If SQLITE_STATUS_ATOMIC is defined, sqlite3StatusAdd() and
+** sqlite3StatusSet() update the status counters using atomic operations.
+** The caller need not hold any mutex.
+*/
+#if SQLITE_THREADSAFE && defined(__GNUC__) \
+ && !defined(SQLITE_DISABLE_STATUS_ATOMIC)
+# define SQLITE_STATUS_ATOMIC 1
+#endif
 int sqlite3StatusValue(int);
 void sqlite3StatusAdd(int, int);
 void sqlite3StatusSet(int, int);
@@ -2812,6 +2929,13 @@ void sqlite3ExprListSetSpan(Parse*,ExprList*,ExprSpan*);
 void sqlite3ExprListDelete(sqlite3*, ExprList*);
 int sqlite3Init(sqlite3*, char**);
 int sqlite3InitCallback(void*, int, char**, char**);
+int sqlite3LazyLoad(sqlite3*, int, const char*);
+int sqlite3LazyLoadObject(sqlite3*, int, const char*);
+void sqlite3LazyLoadAll(sqlite3*, int);
+void sqlite3LazyClear(Schema*);
+void sqlite3LazyRootPageMoved(sqlite3*, int, int);
+int sqlite3LazyStat(sqlite3*, int, char**);
+int sqlite3LazySize(Schema*);
 void sqlite3Pragma(Parse*,Token*,Token*,Token*,int);
 void sqlite3ResetAllSchemasOfConnection(sqlite3*);
 void sqlite3ResetOneSchema(sqlite3*,int);
@@ -3166,6 +3290,7 @@ int sqlite3InvokeBusyHandler(BusyHandler*);
 int sqlite3FindDb(sqlite3*, Token*);
 int sqlite3FindDbName(sqlite3 *, const char *);
 int sqlite3AnalysisLoad(sqlite3*,int iDB);
+void sqlite3AnalysisLoadRow(sqlite3*,int iDB,char**);
 void sqlite3DeleteIndexSamples(sqlite3*,Index*);
 void sqlite3DefaultRowEst(Index*);
 void sqlite3RegisterLikeFunctions(sqlite3*, int);
@@ -49,17 +49,39 @@ int sqlite3StatusValue(int op){
   return wsdStat.nowValue[op];
 }
 
+#ifdef SQLITE_STATUS_ATOMIC
+/*
+** Raise the maximum value *pMx to X, if X is larger. Another thread may
+** be doing the same, so retry until either the compare-and-swap succeeds
+** or *pMx is no longer less than X.
+*/
+static void statusMax(int *pMx, int X){
+  int mx;
+  while( X>(mx = *(volatile int*)pMx) ){
+    if( __sync_bool_compare_and_swap(pMx, mx, X) ) break;
+  }
+}
+#endif
+
 /*
 ** Add N to the value of a status record.  It is assumed that the
-** caller holds appropriate locks.
+** caller holds appropriate locks, unless SQLITE_STATUS_ATOMIC is
+** defined.
 */
 void sqlite3StatusAdd(int op, int N){
   wsdStatInit;
   assert( op>=0 && op<ArraySize(wsdStat.nowValue) );
+#ifdef SQLITE_STATUS_ATOMIC
+  {
+    int nNew = __sync_add_and_fetch(&wsdStat.nowValue[op], N);
+    statusMax(&wsdStat.mxValue[op], nNew);
+  }
+#else
   wsdStat.nowValue[op] += N;
   if( wsdStat.nowValue[op]>wsdStat.mxValue[op] ){
     wsdStat.mxValue[op] = wsdStat.nowValue[op];
   }
+#endif
 }
 
 /*
@@ -69,9 +91,13 @@ void sqlite3StatusSet(int op, int X){
   wsdStatInit;
   assert( op>=0 && op<ArraySize(wsdStat.nowValue) );
   wsdStat.nowValue[op] = X;
+#ifdef SQLITE_STATUS_ATOMIC
+  statusMax(&wsdStat.mxValue[op], X);
+#else
   if( wsdStat.nowValue[op]>wsdStat.mxValue[op] ){
     wsdStat.mxValue[op] = wsdStat.nowValue[op];
   }
+#endif
 }
 
 /*
@@ -132,6 +158,25 @@ int sqlite3_db_status(
       break;
     }
 
+    case SQLITE_DBSTATUS_LOOKASIDE_HIT_256:
+    case SQLITE_DBSTATUS_LOOKASIDE_HIT_512:
+    case SQLITE_DBSTATUS_LOOKASIDE_HIT_1024:
+    case SQLITE_DBSTATUS_LOOKASIDE_MISS_256:
+    case SQLITE_DBSTATUS_LOOKASIDE_MISS_512:
+    case SQLITE_DBSTATUS_LOOKASIDE_MISS_1024: {
+      int iClass = (op - SQLITE_DBSTATUS_LOOKASIDE_HIT_256) % LOOKASIDE_NCLASS;
+      int iStat = (op - SQLITE_DBSTATUS_LOOKASIDE_HIT_256) / LOOKASIDE_NCLASS;
+      LookasideClass *pClass = &db->lookaside.aClass[iClass];
+      assert( LOOKASIDE_NCLASS==3 );
+      assert( iStat==0 || iStat==1 );
+      *pCurrent = 0;
+      *pHighwater = pClass->anStat[iStat];
+      if( resetFlag ){
+        pClass->anStat[iStat] = 0;
+      }
+      break;
+    }
+
     /* 
     ** Return an approximation for the amount of memory currently used
     ** by all pagers associated with the given database connection.  The
@@ -180,6 +225,7 @@ int sqlite3_db_status(
           nByte += sqlite3MallocSize(pSchema->trigHash.ht);
           nByte += sqlite3MallocSize(pSchema->idxHash.ht);
           nByte += sqlite3MallocSize(pSchema->fkeyHash.ht);
+          nByte += sqlite3LazySize(pSchema);
 
           for(p=sqliteHashFirst(&pSchema->trigHash); p; p=sqliteHashNext(p)){
             sqlite3DeleteTrigger(db, (Trigger*)sqliteHashData(p));
@@ -226,7 +272,9 @@ int sqlite3_db_status(
     */
     case SQLITE_DBSTATUS_CACHE_HIT:
     case SQLITE_DBSTATUS_CACHE_MISS:
-    case SQLITE_DBSTATUS_CACHE_WRITE:{
+    case SQLITE_DBSTATUS_CACHE_WRITE:
+    case SQLITE_DBSTATUS_READAHEAD_HIT:
+    case SQLITE_DBSTATUS_READAHEAD_WASTE:{
       int i;
       int nRet = 0;
       assert( SQLITE_DBSTATUS_CACHE_MISS==SQLITE_DBSTATUS_CACHE_HIT+1 );
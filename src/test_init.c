@@ -34,6 +34,7 @@ static struct Wrapped {
   sqlite3_mem_methods     mem;
   sqlite3_mutex_methods   mutex;
 
+  int mem_threadsafe;          /* Saved value of bMemThreadsafe */
   int mem_init;                /* True if mem subsystem is initalized */
   int mem_fail;                /* True to fail mem subsystem inialization */
   int mutex_init;              /* True if mutex subsystem is initalized */
@@ -180,7 +181,10 @@ static void installInitWrappers(void){
   sqlite3_config(SQLITE_CONFIG_GETMALLOC, &wrapped.mem);
   sqlite3_config(SQLITE_CONFIG_GETPCACHE2, &wrapped.pcache);
   sqlite3_config(SQLITE_CONFIG_MUTEX, &mutexmethods);
+  wrapped.mem_threadsafe = sqlite3GlobalConfig.bMemThreadsafe;
   sqlite3_config(SQLITE_CONFIG_MALLOC, &memmethods);
+  /* The wrappers are as threadsafe as the methods they wrap. */
+  sqlite3GlobalConfig.bMemThreadsafe = wrapped.mem_threadsafe;
   sqlite3_config(SQLITE_CONFIG_PCACHE2, &pcachemethods);
 }
 
@@ -223,6 +227,7 @@ static int init_wrapper_uninstall(
   sqlite3_shutdown();
   sqlite3_config(SQLITE_CONFIG_MUTEX, &wrapped.mutex);
   sqlite3_config(SQLITE_CONFIG_MALLOC, &wrapped.mem);
+  sqlite3GlobalConfig.bMemThreadsafe = wrapped.mem_threadsafe;
   sqlite3_config(SQLITE_CONFIG_PCACHE2, &wrapped.pcache);
   return TCL_OK;
 }
@@ -32,6 +32,7 @@ static struct MemFault {
   int isInstalled;        /* True if the fault simulation layer is installed */
   int isBenignMode;       /* True if malloc failures are considered benign */
   sqlite3_mem_methods m;  /* 'Real' malloc implementation */
+  int bThreadsafe;        /* True if m need not be serialized */
 } memfault;
 
 /*
@@ -204,8 +205,13 @@ static int faultsimInstall(int install){
   if( install ){
     rc = sqlite3_config(SQLITE_CONFIG_GETMALLOC, &memfault.m);
     assert(memfault.m.xMalloc);
+    /* The wrapper only modifies memfault while fault simulation is
+    ** enabled, which is never the case in multi-threaded tests. So it is
+    ** as threadsafe as the allocator it wraps.  */
+    memfault.bThreadsafe = sqlite3GlobalConfig.bMemThreadsafe;
     if( rc==SQLITE_OK ){
       rc = sqlite3_config(SQLITE_CONFIG_MALLOC, &m);
+      sqlite3GlobalConfig.bMemThreadsafe = memfault.bThreadsafe;
     }
     sqlite3_test_control(SQLITE_TESTCTRL_BENIGN_MALLOC_HOOKS, 
         faultsimBeginBenign, faultsimEndBenign
@@ -222,6 +228,7 @@ static int faultsimInstall(int install){
     assert( memcmp(&m, &memfault.m, sizeof(m))==0 );
 
     rc = sqlite3_config(SQLITE_CONFIG_MALLOC, &memfault.m);
+    sqlite3GlobalConfig.bMemThreadsafe = memfault.bThreadsafe;
     sqlite3_test_control(SQLITE_TESTCTRL_BENIGN_MALLOC_HOOKS, 0, 0);
   }
 
@@ -934,8 +941,8 @@ static int test_config_pagecache(
   int sz, N, rc;
   Tcl_Obj *pResult;
   static char *buf = 0;
-  if( objc!=3 ){
-    Tcl_WrongNumArgs(interp, 1, objv, "SIZE N");
+  if( objc!=3 && objc!=4 ){
+    Tcl_WrongNumArgs(interp, 1, objv, "SIZE N ?-nobuffer?");
     return TCL_ERROR;
   }
   if( Tcl_GetIntFromObj(interp, objv[1], &sz) ) return TCL_ERROR;
@@ -944,6 +951,10 @@ static int test_config_pagecache(
   if( sz<0 ){
     buf = 0;
     rc = sqlite3_config(SQLITE_CONFIG_PAGECACHE, 0, 0, 0);
+  }else if( objc==4 ){
+    /* Let SQLite allocate the buffer itself */
+    buf = 0;
+    rc = sqlite3_config(SQLITE_CONFIG_PAGECACHE, 0, sz, N);
   }else{
     buf = malloc( sz*N );
     rc = sqlite3_config(SQLITE_CONFIG_PAGECACHE, buf, sz, N);
@@ -1349,7 +1360,15 @@ static int test_db_status(
     { "LOOKASIDE_MISS_FULL", SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL },
     { "CACHE_HIT",           SQLITE_DBSTATUS_CACHE_HIT           },
     { "CACHE_MISS",          SQLITE_DBSTATUS_CACHE_MISS          },
-    { "CACHE_WRITE",         SQLITE_DBSTATUS_CACHE_WRITE         }
+    { "CACHE_WRITE",         SQLITE_DBSTATUS_CACHE_WRITE         },
+    { "READAHEAD_HIT",       SQLITE_DBSTATUS_READAHEAD_HIT       },
+    { "READAHEAD_WASTE",     SQLITE_DBSTATUS_READAHEAD_WASTE     },
+    { "LOOKASIDE_HIT_256",   SQLITE_DBSTATUS_LOOKASIDE_HIT_256   },
+    { "LOOKASIDE_HIT_512",   SQLITE_DBSTATUS_LOOKASIDE_HIT_512   },
+    { "LOOKASIDE_HIT_1024",  SQLITE_DBSTATUS_LOOKASIDE_HIT_1024  },
+    { "LOOKASIDE_MISS_256",  SQLITE_DBSTATUS_LOOKASIDE_MISS_256  },
+    { "LOOKASIDE_MISS_512",  SQLITE_DBSTATUS_LOOKASIDE_MISS_512  },
+    { "LOOKASIDE_MISS_1024", SQLITE_DBSTATUS_LOOKASIDE_MISS_1024 }
   };
   Tcl_Obj *pResult;
   if( objc!=4 ){
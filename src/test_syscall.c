@@ -23,7 +23,7 @@
 **
 **         open        close      access   getcwd   stat      fstat    
 **         ftruncate   fcntl      read     pread    pread64   write
-**         pwrite      pwrite64   fchmod   fallocate mmap
+**         pwrite      pwrite64   fchmod   fallocate mmap     pwritev
 **
 **   test_syscall uninstall
 **     Uninstall all wrapper functions.
@@ -83,6 +83,7 @@ extern const char *sqlite3ErrName(int);
 
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <errno.h>
 
 static struct TestSyscallGlobal {
@@ -109,6 +110,7 @@ static int ts_fchmod(int fd, mode_t mode);
 static int ts_fallocate(int fd, off_t off, off_t len);
 static void *ts_mmap(void *, size_t, int, int, int, off_t);
 static void *ts_mremap(void*, size_t, size_t, int, ...);
+static ssize_t ts_pwritev(int, const struct iovec*, int, off_t);
 
 struct TestSyscallArray {
   const char *zName;
@@ -135,6 +137,7 @@ struct TestSyscallArray {
   /* 15 */ { "fallocate", (sqlite3_syscall_ptr)ts_fallocate, 0, 0, 0 },
   /* 16 */ { "mmap",      (sqlite3_syscall_ptr)ts_mmap,      0, 0, 0 },
   /* 17 */ { "mremap",    (sqlite3_syscall_ptr)ts_mremap,    0, 0, 0 },
+  /* 18 */ { "pwritev",   (sqlite3_syscall_ptr)ts_pwritev,   0, 0, 0 },
            { 0, 0, 0, 0, 0 }
 };
 
@@ -158,6 +161,8 @@ struct TestSyscallArray {
 #define orig_fallocate ((int(*)(int,off_t,off_t))aSyscall[15].xOrig)
 #define orig_mmap      ((void*(*)(void*,size_t,int,int,int,off_t))aSyscall[16].xOrig)
 #define orig_mremap    ((void*(*)(void*,size_t,size_t,int,...))aSyscall[17].xOrig)
+#define orig_pwritev   ((ssize_t(*)(int,const struct iovec*,int,off_t))\
+                       aSyscall[18].xOrig)
 
 /*
 ** This function is called exactly once from within each invocation of a
@@ -408,6 +413,21 @@ static void *ts_mremap(void *a, size_t b, size_t c, int d, ...){
   return orig_mremap(a, b, c, d, pArg);
 }
 
+/*
+** A wrapper around pwritev().
+*/
+static ssize_t ts_pwritev(
+  int fd, 
+  const struct iovec *aIov, 
+  int nIov, 
+  off_t off
+){
+  if( tsIsFailErrno("pwritev") ){
+    return -1;
+  }
+  return orig_pwritev(fd, aIov, nIov, off);
+}
+
 static int test_syscall_install(
   void * clientData,
   Tcl_Interp *interp,
@@ -0,0 +1,100 @@
+/*
+** 2026 October 18
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+*************************************************************************
+**
+** This file contains a minimal interface for running a task in a worker
+** thread, for use internally by SQLite.
+**
+** sqlite3ThreadCreate() starts a task. The task runs independently of
+** its creator until sqlite3ThreadJoin() is called to wait for it and
+** collect its result.
+**
+** Nothing in SQLite depends on the task actually running in parallel.
+** If threads are not available, or a thread cannot be started, the task
+** is run to completion by sqlite3ThreadCreate() itself. Worker tasks must
+** not make any SQLite API calls, and must not use any object that the
+** creating thread might use before the task is joined.
+*/
+#include "sqliteInt.h"
+
+#if SQLITE_MAX_WORKER_THREADS>0
+
+#if SQLITE_OS_UNIX && defined(SQLITE_MUTEX_PTHREADS)
+#include <pthread.h>
+#define SQLITE_THREADS_PTHREADS 1
+#endif
+
+/*
+** An instance of this object represents one task started by
+** sqlite3ThreadCreate().
+*/
+struct SQLiteThread {
+#ifdef SQLITE_THREADS_PTHREADS
+  pthread_t tid;                  /* Thread running the task */
+#endif
+  int done;                       /* True if pOut is already valid */
+  void *pOut;                     /* Value returned by the task */
+};
+
+/*
+** Start a task that runs xTask(pIn). If successful, set *ppThread to
+** point to a new object that must be passed to sqlite3ThreadJoin() and
+** return SQLITE_OK. Otherwise, if a malloc fails, set *ppThread to 0
+** and return SQLITE_NOMEM without running the task.
+*/
+int sqlite3ThreadCreate(
+  SQLiteThread **ppThread,        /* OUT: New thread object */
+  void *(*xTask)(void*),          /* Routine to run */
+  void *pIn                       /* Argument passed to xTask() */
+){
+  SQLiteThread *p;
+
+  assert( ppThread!=0 && xTask!=0 );
+  *ppThread = 0;
+  p = (SQLiteThread*)sqlite3MallocZero(sizeof(*p));
+  if( p==0 ) return SQLITE_NOMEM;
+
+#ifdef SQLITE_THREADS_PTHREADS
+  /* Threads are only used if SQLite is using its own mutexes, as a task
+  ** may call sqlite3_malloc() or a VFS method. */
+  if( sqlite3GlobalConfig.bCoreMutex==0
+   || pthread_create(&p->tid, 0, xTask, pIn)
+  )
+#endif
+  {
+    p->done = 1;
+    p->pOut = xTask(pIn);
+  }
+  *ppThread = p;
+  return SQLITE_OK;
+}
+
+/*
+** Wait for the task started by sqlite3ThreadCreate() to finish, set
+** *ppOut to the value it returned and free the thread object.
+*/
+int sqlite3ThreadJoin(SQLiteThread *p, void **ppOut){
+  int rc = SQLITE_OK;
+
+  assert( ppOut!=0 );
+  if( p->done ){
+    *ppOut = p->pOut;
+  }
+#ifdef SQLITE_THREADS_PTHREADS
+  else if( pthread_join(p->tid, ppOut) ){
+    rc = SQLITE_ERROR;
+  }
+#endif
+  sqlite3_free(p);
+  return rc;
+}
+
+#endif /* SQLITE_MAX_WORKER_THREADS>0 */
@@ -180,6 +180,7 @@ void sqlite3BeginTrigger(
     goto trigger_cleanup;
   }
   assert( sqlite3SchemaMutexHeld(db, iDb, 0) );
+  sqlite3LazyLoadObject(db, iDb, zName);
   if( sqlite3HashFind(&(db->aDb[iDb].pSchema->trigHash),
                       zName, sqlite3Strlen30(zName)) ){
     if( !noErr ){
@@ -509,6 +510,9 @@ void sqlite3DropTrigger(Parse *pParse, SrcList *pName, int noErr){
     if( zDb && sqlite3StrICmp(db->aDb[j].zName, zDb) ) continue;
     assert( sqlite3SchemaMutexHeld(db, j, 0) );
     pTrigger = sqlite3HashFind(&(db->aDb[j].pSchema->trigHash), zName, nName);
+    if( pTrigger==0 && sqlite3LazyLoadObject(db, j, zName) ){
+      pTrigger = sqlite3HashFind(&(db->aDb[j].pSchema->trigHash),zName,nName);
+    }
     if( pTrigger ) break;
   }
   if( !pTrigger ){
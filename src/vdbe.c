@@ -2716,6 +2716,7 @@ case OP_Savepoint: {
         ** "transaction savepoint". */
         if( db->autoCommit ){
           db->autoCommit = 0;
+          db->bConcurrent = 0;
           db->isTransactionSavepoint = 1;
         }else{
           db->nSavepoint++;
@@ -2824,13 +2825,16 @@ case OP_Savepoint: {
   break;
 }
 
-/* Opcode: AutoCommit P1 P2 * * *
+/* Opcode: AutoCommit P1 P2 P3 * *
 **
 ** Set the database auto-commit flag to P1 (1 or 0). If P2 is true, roll
 ** back any currently active btree transactions. If there are any active
 ** VMs (apart from this one), then a ROLLBACK fails.  A COMMIT fails if
 ** there are active writing VMs or active VMs that use shared cache.
 **
+** If P3 is true, the transaction being opened is a BEGIN CONCURRENT
+** transaction.
+**
 ** This instruction causes the VM to halt.
 */
 case OP_AutoCommit: {
@@ -2872,6 +2876,7 @@ case OP_AutoCommit: {
       goto vdbe_return;
     }else{
       db->autoCommit = (u8)desiredAutoCommit;
+      if( desiredAutoCommit==0 ) db->bConcurrent = (u8)pOp->p3;
       if( sqlite3VdbeHalt(p)==SQLITE_BUSY ){
         p->pc = pc;
         db->autoCommit = (u8)(1-desiredAutoCommit);
@@ -5642,6 +5647,40 @@ case OP_IncrVacuum: {        /* jump */
 }
 #endif
 
+#if !defined(SQLITE_OMIT_AUTOVACUUM)
+/* Opcode: Compact P1 P2 P3 * P5
+**
+** Shrink database P5 by up to N pages, where N is the integer value held
+** in register P3, by moving pages from the end of the file into free pages
+** nearer its start. The P2 registers starting at P1 hold the root page 
+** numbers of every table and index in the database. They are used to 
+** locate the pages that must be updated when a page is moved in a 
+** database that has no pointer-map.
+*/
+case OP_Compact: {
+  int nRoot;      /* Number of root pages */
+  int *aRoot;     /* Array of root page numbers */
+  int j;          /* Loop counter */
+
+  nRoot = pOp->p2;
+  aRoot = sqlite3DbMallocRaw(db, sizeof(int)*(nRoot+1));
+  if( aRoot==0 ) goto no_mem;
+  pIn1 = &aMem[pOp->p1];
+  for(j=0; j<nRoot; j++){
+    aRoot[j] = (int)sqlite3VdbeIntValue(&pIn1[j]);
+  }
+  aRoot[j] = 0;
+  assert( pOp->p5<db->nDb );
+  assert( (p->btreeMask & (((yDbMask)1)<<pOp->p5))!=0 );
+  pIn3 = &aMem[pOp->p3];
+  assert( (pIn3->flags & MEM_Int)!=0 );
+  rc = sqlite3BtreeCompact(db->aDb[pOp->p5].pBt, aRoot, nRoot,
+                           (int)pIn3->u.i);
+  sqlite3DbFree(db, aRoot);
+  break;
+}
+#endif
+
 /* Opcode: Expire P1 * * * *
 **
 ** Cause precompiled statements to become expired. An expired statement
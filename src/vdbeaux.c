@@ -1493,7 +1493,8 @@ void sqlite3VdbeMakeReady(
   zEnd = (u8*)&p->aOp[p->nOpAlloc];  /* First byte past end of zCsr[] */
 
   resolveP2Values(p, &nArg);
-  p->usesStmtJournal = (u8)(pParse->isMultiWrite && pParse->mayAbort);
+  p->usesStmtJournal = (u8)((pParse->isMultiWrite && pParse->mayAbort)
+                            || pParse->needStmtJournal);
   if( pParse->explain && nMem<10 ){
     nMem = 10;
   }
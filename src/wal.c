@@ -371,7 +371,9 @@ struct WalCkptInfo {
 /* A block of WALINDEX_LOCK_RESERVED bytes beginning at
 ** WALINDEX_LOCK_OFFSET is reserved for locks. Since some systems
 ** only support mandatory file-locks, we do not read or write data
-** from the region of the file on which locks are applied.
+** from the region of the file on which locks are applied. The unix
+** VFS uses the last 4 bytes of the block, which are never locked, to
+** wake connections waiting for a lock (see unixShmWake()).
 */
 #define WALINDEX_LOCK_OFFSET   (sizeof(WalIndexHdr)*2 + sizeof(WalCkptInfo))
 #define WALINDEX_LOCK_RESERVED 16
@@ -427,9 +429,15 @@ struct Wal {
   u8 truncateOnCommit;       /* True to truncate WAL file on commit */
   u8 syncHeader;             /* Fsync the WAL header if true */
   u8 padToSectorBoundary;    /* Pad transactions out to the next sector */
+  u8 nCkptThread;            /* Worker threads to use for checkpoints */
   WalIndexHdr hdr;           /* Wal-index header for current transaction */
+  u32 minFrame;              /* Ignore wal frames before this one */
   const char *zWalName;      /* Name of WAL file */
   u32 nCkpt;                 /* Checkpoint sequence counter in the wal-header */
+  u8 *aFilter;               /* Bitmap of pages that may be in the WAL */
+  u32 nFilter;               /* Size of aFilter[] in bits */
+  u32 iFilter;               /* aFilter[] describes frames 1 to iFilter */
+  u32 aFilterSalt[2];        /* Salt values of WAL described by aFilter[] */
 #ifdef SQLITE_DEBUG
   u8 lockError;              /* True if a locking error has occurred */
 #endif
@@ -506,6 +514,16 @@ struct WalIterator {
     sizeof(ht_slot)*HASHTABLE_NSLOT + HASHTABLE_NPAGE*sizeof(u32) \
 )
 
+/*
+** Parameters for the Wal.aFilter[] bitmap used by sqlite3WalFindFrame().
+** The bitmap is only used if a lookup would otherwise search more than
+** WAL_FILTER_NHASH hash tables. Its size in bits is a power of two
+** between WAL_FILTER_MINBIT and WAL_FILTER_MAXBIT.
+*/
+#define WAL_FILTER_NHASH    2
+#define WAL_FILTER_MINBIT   (1<<15)       /* 4KiB */
+#define WAL_FILTER_MAXBIT   (1<<24)       /* 2MiB */
+
 /*
 ** Obtain a pointer to the iPage'th page of the wal-index. The wal-index
 ** is broken into pages of WALINDEX_PGSZ bytes. Wal-index pages are
@@ -1324,6 +1342,15 @@ void sqlite3WalLimit(Wal *pWal, i64 iLimit){
   if( pWal ) pWal->mxWalSize = iLimit;
 }
 
+/*
+** Set the number of worker threads, in addition to the calling thread,
+** that a checkpoint may use to write to the database file.
+*/
+void sqlite3WalCheckpointThreads(Wal *pWal, int nThread){
+  assert( nThread>=0 && nThread<=SQLITE_MAX_WORKER_THREADS );
+  if( pWal ) pWal->nCkptThread = (u8)nThread;
+}
+
 /*
 ** Find the smallest page number out of all pages held in the WAL that
 ** has not been returned by any prior invocation of this method on the
@@ -1623,6 +1650,138 @@ static int walPagesize(Wal *pWal){
   return (pWal->hdr.szPage&0xfe00) + ((pWal->hdr.szPage&0x0001)<<16);
 }
 
+/*
+** walCheckpoint() copies pages from the WAL file into the database file
+** in batches. This is the size in bytes of the buffer used to hold each
+** batch of pages.
+*/
+#define WAL_CKPT_BUFFER (256*1024)
+
+/*
+** The maximum number of consecutive database pages that walCheckpoint()
+** writes with a single call to sqlite3OsWritev().
+*/
+#define WAL_CKPT_RUN 64
+
+/*
+** The maximum number of bytes that walCheckpoint() reads from the WAL
+** file with a single call to sqlite3OsRead(), unless a single page is
+** larger than this.
+*/
+#define WAL_CKPT_READ SQLITE_MAX_PAGE_SIZE
+
+/*
+** An instance of the following object holds a batch of pages that have
+** been read from the WAL file by walCheckpoint() and are to be written
+** into the database file. Page aPgno[i] is stored at offset
+** (i*(szPage+WAL_FRAME_HDRSIZE)) of aBuf[]. The space between pages is
+** for the frame headers that are read along with them.
+**
+** A batch may be written by a worker thread, in which case pThread is
+** the thread. Only the thread writing the batch uses the object until
+** the thread is joined.
+*/
+typedef struct WalCkptBatch WalCkptBatch;
+struct WalCkptBatch {
+  sqlite3_file *pDbFd;            /* Database file to write to */
+  int szPage;                     /* Database page size in bytes */
+  int nPage;                      /* Number of pages in batch */
+  u32 *aPgno;                     /* Page numbers, in ascending order */
+  u8 *aBuf;                       /* Page data */
+  int rc;                         /* Result of writing the batch */
+#if SQLITE_MAX_WORKER_THREADS>0
+  SQLiteThread *pThread;          /* Thread writing the batch, or NULL */
+#endif
+};
+
+/*
+** Read a batch of p->nPage pages from the WAL file. aFrame[i] is the
+** frame that contains page p->aPgno[i]. Pages stored in consecutive
+** frames are read with a single call to sqlite3OsRead(), up to a limit
+** of WAL_CKPT_READ bytes.
+*/
+static int walCkptRead(Wal *pWal, WalCkptBatch *p, u32 *aFrame){
+  int szFrame = p->szPage + WAL_FRAME_HDRSIZE;
+  int rc = SQLITE_OK;
+  int i;                          /* First page to read */
+  int n;                          /* Number of pages to read */
+
+  for(i=0; rc==SQLITE_OK && i<p->nPage; i+=n){
+    i64 iOffset = walFrameOffset(aFrame[i], p->szPage) + WAL_FRAME_HDRSIZE;
+    /* testcase( IS_BIG_INT(iOffset) ); // requires a 4GiB WAL file */
+    for(n=1; i+n<p->nPage && aFrame[i+n]==aFrame[i]+n
+          && (n+1)*szFrame-WAL_FRAME_HDRSIZE<=WAL_CKPT_READ; n++);
+    rc = sqlite3OsRead(pWal->pWalFd, 
+        &p->aBuf[i*szFrame], n*szFrame - WAL_FRAME_HDRSIZE, iOffset
+    );
+  }
+  return rc;
+}
+
+/*
+** Write the batch of pages passed as the only argument into the database
+** file. Each run of consecutive pages is written with a single call to
+** sqlite3OsWritev(). The result is stored in WalCkptBatch.rc.
+**
+** This function is called either directly or as a worker thread task.
+*/
+static void *walCkptWrite(void *pCtx){
+  WalCkptBatch *p = (WalCkptBatch*)pCtx;
+  int szFrame = p->szPage + WAL_FRAME_HDRSIZE;
+  const void *apRun[WAL_CKPT_RUN];
+  int rc = SQLITE_OK;
+  int i;                          /* First page of run */
+  int n;                          /* Number of pages in run */
+
+  for(i=0; rc==SQLITE_OK && i<p->nPage; i+=n){
+    i64 iOffset = (p->aPgno[i]-1)*(i64)p->szPage;
+    testcase( IS_BIG_INT(iOffset) );
+    apRun[0] = &p->aBuf[i*szFrame];
+    for(n=1; i+n<p->nPage && n<ArraySize(apRun)
+          && p->aPgno[i+n]==p->aPgno[i]+n; n++){
+      apRun[n] = &p->aBuf[(i+n)*szFrame];
+    }
+    rc = sqlite3OsWritev(p->pDbFd, n, apRun, p->szPage, iOffset);
+  }
+  p->rc = rc;
+  return 0;
+}
+
+/*
+** Write the batch of pages in p into the database file, either directly
+** or by starting a worker thread if bThread is true.
+*/
+static void walCkptStart(WalCkptBatch *p, int bThread){
+#if SQLITE_MAX_WORKER_THREADS>0
+  assert( p->pThread==0 );
+  if( bThread && sqlite3ThreadCreate(&p->pThread, walCkptWrite, p)==SQLITE_OK ){
+    return;
+  }
+#else
+  UNUSED_PARAMETER(bThread);
+#endif
+  walCkptWrite(p);
+}
+
+/*
+** Wait for the worker thread writing the batch of pages in p, if any, to
+** finish. Return the result of writing the batch, or SQLITE_OK if there
+** are no pages in the batch.
+*/
+static int walCkptFinish(WalCkptBatch *p){
+  int rc;
+#if SQLITE_MAX_WORKER_THREADS>0
+  if( p->pThread ){
+    void *pOut;
+    if( sqlite3ThreadJoin(p->pThread, &pOut) ) p->rc = SQLITE_ERROR;
+    p->pThread = 0;
+  }
+#endif
+  rc = (p->nPage ? p->rc : SQLITE_OK);
+  p->nPage = 0;
+  return rc;
+}
+
 /*
 ** Copy as much content as we can from the WAL back into the database file
 ** in response to an sqlite3_wal_checkpoint() request or the equivalent.
@@ -1672,6 +1831,14 @@ static int walCheckpoint(
   int i;                          /* Loop counter */
   volatile WalCkptInfo *pInfo;    /* The checkpoint status information */
   int (*xBusy)(void*) = 0;        /* Function to call when waiting for locks */
+  WalCkptBatch *aBatch = 0;       /* Batches of pages being copied */
+  WalCkptBatch sBatch;            /* Used if aBatch[] cannot be allocated */
+  int nBatch = 1;                 /* Number of entries in aBatch[] */
+  int mxBatch;                    /* Maximum pages in a single batch */
+  u32 *aFrame;                    /* WAL frame for each page of a batch */
+  u32 aFrame1[1];                 /* Used if aBatch[] cannot be allocated */
+  u32 iPgno1;                     /* Used if aBatch[] cannot be allocated */
+  int bThread = 0;                /* True to use worker threads */
 
   szPage = walPagesize(pWal);
   testcase( szPage<=32768 );
@@ -1734,21 +1901,87 @@ static int walCheckpoint(
       }
     }
 
+    /* Decide whether or not to write to the database file using worker
+    ** threads. If so, there is one batch being filled by this thread
+    ** while up to nCkptThread others are written in the background. */
+#if SQLITE_MAX_WORKER_THREADS>0
+    if( rc==SQLITE_OK && pWal->nCkptThread>0
+     && sqlite3GlobalConfig.bCoreMutex
+     && sqlite3OsFileControl(pWal->pDbFd, SQLITE_FCNTL_PARALLEL_WRITE,
+                             (void*)pWal->pDbFd)==SQLITE_OK
+    ){
+      bThread = 1;
+      nBatch = pWal->nCkptThread + 1;
+    }
+#endif
 
-    /* Iterate through the contents of the WAL, copying data to the db file. */
-    while( rc==SQLITE_OK && 0==walIteratorNext(pIter, &iDbpage, &iFrame) ){
-      i64 iOffset;
-      assert( walFramePgno(pWal, iFrame)==iDbpage );
-      if( iFrame<=nBackfill || iFrame>mxSafeFrame || iDbpage>mxPage ) continue;
-      iOffset = walFrameOffset(iFrame, szPage) + WAL_FRAME_HDRSIZE;
-      /* testcase( IS_BIG_INT(iOffset) ); // requires a 4GiB WAL file */
-      rc = sqlite3OsRead(pWal->pWalFd, zBuf, szPage, iOffset);
-      if( rc!=SQLITE_OK ) break;
-      iOffset = (iDbpage-1)*(i64)szPage;
-      testcase( IS_BIG_INT(iOffset) );
-      rc = sqlite3OsWrite(pWal->pDbFd, zBuf, szPage, iOffset);
-      if( rc!=SQLITE_OK ) break;
+    /* Allocate the batches. If the allocation fails, copy one page at a
+    ** time using zBuf. */
+    mxBatch = WAL_CKPT_BUFFER / (szPage + WAL_FRAME_HDRSIZE);
+    if( mxBatch<1 ) mxBatch = 1;
+    sqlite3BeginBenignMalloc();
+    aBatch = (WalCkptBatch*)sqlite3MallocZero(
+        nBatch * (sizeof(WalCkptBatch) + mxBatch*(sizeof(u32)+8)
+                  + mxBatch*(szPage+WAL_FRAME_HDRSIZE))
+        + mxBatch*sizeof(u32)
+    );
+    sqlite3EndBenignMalloc();
+    if( aBatch ){
+      u8 *pSpace = (u8*)&aBatch[nBatch];
+      for(i=0; i<nBatch; i++){
+        aBatch[i].aBuf = pSpace;
+        pSpace += mxBatch*(szPage+WAL_FRAME_HDRSIZE);
+        aBatch[i].aPgno = (u32*)pSpace;
+        pSpace += ROUND8(mxBatch*sizeof(u32));
+      }
+      aFrame = (u32*)pSpace;
+    }else{
+      memset(&sBatch, 0, sizeof(sBatch));
+      aBatch = &sBatch;
+      sBatch.aBuf = zBuf;
+      sBatch.aPgno = &iPgno1;
+      aFrame = aFrame1;
+      nBatch = 1;
+      mxBatch = 1;
+      bThread = 0;
+    }
+    for(i=0; i<nBatch; i++){
+      aBatch[i].pDbFd = pWal->pDbFd;
+      aBatch[i].szPage = szPage;
+    }
+
+    /* Iterate through the contents of the WAL, copying data to the db 
+    ** file. Pages are read into each batch in turn. Before a batch is
+    ** filled, the write of its previous contents must be finished. */
+    i = 0;
+    while( rc==SQLITE_OK ){
+      WalCkptBatch *p = &aBatch[i];
+      rc = walCkptFinish(p);
+      while( rc==SQLITE_OK && p->nPage<mxBatch
+          && 0==walIteratorNext(pIter, &iDbpage, &iFrame)
+      ){
+        assert( walFramePgno(pWal, iFrame)==iDbpage );
+        if( iFrame<=nBackfill || iFrame>mxSafeFrame || iDbpage>mxPage ){
+          continue;
+        }
+        p->aPgno[p->nPage] = iDbpage;
+        aFrame[p->nPage] = iFrame;
+        p->nPage++;
+      }
+      if( rc==SQLITE_OK && p->nPage>0 ){
+        rc = walCkptRead(pWal, p, aFrame);
+        if( rc==SQLITE_OK ) walCkptStart(p, bThread);
+      }
+      if( p->nPage<mxBatch ) break;
+      i = (i+1) % nBatch;
+    }
+
+    /* Wait for the remaining batches to be written */
+    for(i=0; i<nBatch; i++){
+      int rc2 = walCkptFinish(&aBatch[i]);
+      if( rc==SQLITE_OK ) rc = rc2;
     }
+    if( aBatch!=&sBatch ) sqlite3_free(aBatch);
 
     /* If work was actually accomplished... */
     if( rc==SQLITE_OK ){
@@ -1876,6 +2109,7 @@ int sqlite3WalClose(
     }
     WALTRACE(("WAL%p: closed\n", pWal));
     sqlite3_free((void *)pWal->apWiData);
+    sqlite3_free(pWal->aFilter);
     sqlite3_free(pWal);
   }
   return rc;
@@ -2233,7 +2467,15 @@ static int walTryBeginRead(Wal *pWal, int *pChanged, int useWal, int cnt){
     ** blocking writers. It only guarantees that a dangerous checkpoint or 
     ** log-wrap (either of which would require an exclusive lock on
     ** WAL_READ_LOCK(mxI)) has not occurred since the snapshot was valid.
+    **
+    ** The value of nBackfill is read before the check for the same reason.
+    ** Frames up to and including nBackfill have already been copied into
+    ** the database file, and no checkpointer can overwrite the database
+    ** file with frames that lie beyond this reader's snapshot while the
+    ** lock is held. So sqlite3WalFindFrame() need not search the part of
+    ** the wal-index that covers those frames.
     */
+    pWal->minFrame = pInfo->nBackfill+1;
     walShmBarrier(pWal);
     if( pInfo->aReadMark[mxI]!=mxReadMark
      || memcmp((void *)walIndexHdr(pWal), &pWal->hdr, sizeof(WalIndexHdr))
@@ -2288,6 +2530,77 @@ void sqlite3WalEndReadTransaction(Wal *pWal){
   }
 }
 
+/*
+** This function is called whenever pWal->hdr.mxFrame is decreased without
+** a change in the salt values, for example by a rollback. Frames beyond
+** the new mxFrame will be overwritten by later writers, so they may no
+** longer be considered as described by the Wal.aFilter[] bitmap.
+*/
+static void walFilterRewind(Wal *pWal){
+  if( pWal->iFilter>pWal->hdr.mxFrame ) pWal->iFilter = pWal->hdr.mxFrame;
+}
+
+/*
+** Bring the Wal.aFilter[] bitmap up to date with the current snapshot.
+**
+** Bit (P % Wal.nFilter) of the bitmap is set if page P appears in any of
+** frames 1 to Wal.iFilter of the WAL file. If a bit is clear, there is no
+** need to search the wal-index hash tables for the page. The number of
+** bits is the smallest power of two, between WAL_FILTER_MINBIT and
+** WAL_FILTER_MAXBIT, that is not less than the size of the database, so
+** that each page usually has a bit of its own.
+**
+** The bitmap is built incrementally as the snapshot grows. It is started
+** again from scratch when the WAL file is restarted, which is detected 
+** by a change in the salt values, or when the database grows so large
+** that a bigger bitmap is required. If the snapshot shrinks (because a
+** write transaction was rolled back), walFilterRewind() moves Wal.iFilter
+** back with it. Bits already set are left set, as the bitmap may safely
+** describe pages that are not in the WAL.
+**
+** If a malloc fails, Wal.aFilter is left set to NULL and the hash tables
+** are searched as usual.
+*/
+static int walFilterUpdate(Wal *pWal){
+  u32 mxFrame = pWal->hdr.mxFrame;
+  u32 nBit = WAL_FILTER_MINBIT;
+  u32 iFrame;
+
+  while( nBit<pWal->hdr.nPage && nBit<WAL_FILTER_MAXBIT ) nBit = nBit*2;
+  if( nBit>pWal->nFilter
+   || memcmp(pWal->aFilterSalt, pWal->hdr.aSalt, sizeof(pWal->hdr.aSalt))
+  ){
+    sqlite3_free(pWal->aFilter);
+    sqlite3BeginBenignMalloc();
+    pWal->aFilter = (u8*)sqlite3MallocZero(nBit/8);
+    sqlite3EndBenignMalloc();
+    pWal->nFilter = (pWal->aFilter ? nBit : 0);
+    pWal->iFilter = 0;
+    memcpy(pWal->aFilterSalt, pWal->hdr.aSalt, sizeof(pWal->hdr.aSalt));
+    if( pWal->aFilter==0 ) return SQLITE_OK;
+  }
+  walFilterRewind(pWal);
+
+  for(iFrame=pWal->iFilter+1; iFrame<=mxFrame; ){
+    volatile ht_slot *aHash;      /* Unused */
+    volatile u32 *aPgno;          /* Page number array for hash table */
+    u32 iZero;                    /* Frame number corresponding to aPgno[0] */
+    u32 iEnd;                     /* Last frame of this table to read */
+    int rc;
+
+    rc = walHashGet(pWal, walFramePage(iFrame), &aHash, &aPgno, &iZero);
+    if( rc!=SQLITE_OK ) return rc;
+    iEnd = iZero + (iZero==0 ? HASHTABLE_NPAGE_ONE : HASHTABLE_NPAGE);
+    if( iEnd>mxFrame ) iEnd = mxFrame;
+    for(; iFrame<=iEnd; iFrame++){
+      u32 iBit = aPgno[iFrame-iZero] & (pWal->nFilter-1);
+      pWal->aFilter[iBit/8] |= (u8)(1 << (iBit&7));
+    }
+    pWal->iFilter = iEnd;
+  }
+  return SQLITE_OK;
+}
+
 /*
 ** Search the wal file for page pgno. If found, set *piRead to the frame that
 ** contains the page. Otherwise, if pgno is not in the wal file, set *piRead
@@ -2304,6 +2617,7 @@ int sqlite3WalFindFrame(
   u32 iRead = 0;                  /* If !=0, WAL frame to return data from */
   u32 iLast = pWal->hdr.mxFrame;  /* Last page in WAL for this reader */
   int iHash;                      /* Used to loop through N hash tables */
+  int iMinHash;                   /* Hash table that contains minFrame */
 
   /* This routine is only be called from within a read transaction. */
   assert( pWal->readLock>=0 || pWal->lockError );
@@ -2319,6 +2633,22 @@ int sqlite3WalFindFrame(
     return SQLITE_OK;
   }
 
+  /* If more than a few hash tables would have to be searched, consult
+  ** the Wal.aFilter[] bitmap first. If the bit for pgno is clear, the
+  ** page is not in the WAL.  */
+  iMinHash = walFramePage(pWal->minFrame);
+  if( walFramePage(iLast)-iMinHash>=WAL_FILTER_NHASH ){
+    int rc = walFilterUpdate(pWal);
+    if( rc!=SQLITE_OK ) return rc;
+    if( pWal->aFilter ){
+      u32 iBit = pgno & (pWal->nFilter-1);
+      if( (pWal->aFilter[iBit/8] & (1 << (iBit&7)))==0 ){
+        *piRead = 0;
+        return SQLITE_OK;
+      }
+    }
+  }
+
   /* Search the hash table or tables for an entry matching page number
   ** pgno. Each iteration of the following for() loop searches one
   ** hash table (each hash table indexes up to HASHTABLE_NPAGE frames).
@@ -2343,8 +2673,17 @@ int sqlite3WalFindFrame(
   **   (iFrame<=iLast): 
   **     This condition filters out entries that were added to the hash
   **     table after the current read-transaction had started.
+  **
+  **   (iFrame>=pWal->minFrame): 
+  **     Frames before minFrame had already been copied into the database
+  **     file when the read-transaction was opened. If the most recent
+  **     frame for pgno is one of these, the page is read from the database
+  **     file instead. This means that hash tables that only index frames
+  **     before minFrame need not be searched at all, so that the cost of
+  **     a lookup does not grow with the part of the WAL that has already
+  **     been checkpointed.
   */
-  for(iHash=walFramePage(iLast); iHash>=0 && iRead==0; iHash--){
+  for(iHash=walFramePage(iLast); iHash>=iMinHash && iRead==0; iHash--){
     volatile ht_slot *aHash;      /* Pointer to hash table */
     volatile u32 *aPgno;          /* Pointer to array of page numbers */
     u32 iZero;                    /* Frame number corresponding to aPgno[0] */
@@ -2359,7 +2698,8 @@ int sqlite3WalFindFrame(
     nCollide = HASHTABLE_NSLOT;
     for(iKey=walHash(pgno); aHash[iKey]; iKey=walNextHash(iKey)){
       u32 iFrame = aHash[iKey] + iZero;
-      if( iFrame<=iLast && aPgno[aHash[iKey]]==pgno ){
+      if( iFrame<=iLast && iFrame>=pWal->minFrame
+       && aPgno[aHash[iKey]]==pgno ){
         /* assert( iFrame>iRead ); -- not true if there is corruption */
         iRead = iFrame;
       }
@@ -2376,7 +2716,7 @@ int sqlite3WalFindFrame(
   {
     u32 iRead2 = 0;
     u32 iTest;
-    for(iTest=iLast; iTest>0; iTest--){
+    for(iTest=iLast; iTest>=pWal->minFrame && iTest>0; iTest--){
       if( walFramePgno(pWal, iTest)==pgno ){
         iRead2 = iTest;
         break;
@@ -2469,6 +2809,119 @@ int sqlite3WalBeginWriteTransaction(Wal *pWal){
   return rc;
 }
 
+/*
+** This routine is called in place of sqlite3WalBeginWriteTransaction()
+** by a concurrent write transaction (one opened by BEGIN CONCURRENT) once
+** it is ready to commit. Bitvec pRead contains the number of every page
+** read or written by the transaction.
+**
+** Obtain the write lock, returning SQLITE_BUSY if it is not available. If
+** other connections have committed transactions since the read transaction
+** on this connection was opened, check the page number of each frame they
+** wrote against pRead. If any of those pages were used by this transaction,
+** release the write lock and return SQLITE_BUSY_SNAPSHOT.
+**
+** Otherwise, move this connection's snapshot forward to the current end
+** of the log and invoke the xUndo callback for each page written by the
+** other transactions, so that the caller can discard stale copies of them
+** from its cache. Return SQLITE_OK with the write lock held.
+**
+** Page 1 is not checked against pRead, as every transaction reads it. If
+** the other transactions wrote page 1, xUndo is invoked for it once, after
+** all other pages. The caller checks for conflicts within page 1 then,
+** and xUndo returns SQLITE_BUSY_SNAPSHOT if there are any.
+*/
+int sqlite3WalLockForCommit(
+  Wal *pWal,                      /* WAL handle */
+  Bitvec *pRead,                  /* Pages read by this transaction */
+  int (*xUndo)(void *, Pgno),     /* Called for each page written by others */
+  void *pUndoCtx                  /* First argument passed to xUndo */
+){
+  WalIndexHdr hdr;                /* Snapshot the transaction was run on */
+  int bChanged = 0;               /* Unused */
+  u32 iFirst;                     /* First frame written by another txn */
+  u32 iFrame;                     /* Used to iterate through new frames */
+  int bPage1 = 0;                 /* True if page 1 is in a new frame */
+  int rc;
+
+  assert( pWal->readLock>=0 && pWal->writeLock==0 );
+  if( pWal->readOnly ){
+    return SQLITE_READONLY;
+  }
+  rc = walLockExclusive(pWal, WAL_WRITE_LOCK, 1);
+  if( rc ){
+    return rc;
+  }
+  pWal->writeLock = 1;
+  if( memcmp(&pWal->hdr, (void *)walIndexHdr(pWal), sizeof(WalIndexHdr))==0 ){
+    return SQLITE_OK;
+  }
+
+  /* Load the current wal-index header. It cannot change while the write
+  ** lock is held. If it cannot be read, treat this as a conflict. */
+  memcpy(&hdr, &pWal->hdr, sizeof(WalIndexHdr));
+  if( walIndexTryHdr(pWal, &bChanged) ){
+    memcpy(&pWal->hdr, &hdr, sizeof(WalIndexHdr));
+    walFilterRewind(pWal);
+    rc = SQLITE_BUSY_SNAPSHOT;
+  }
+
+  /* If the salt values have changed, the log has been restarted and every
+  ** frame in it was written by another transaction. This is only possible
+  ** if this connection is not using the log at all (readLock==0), as the
+  ** log cannot be restarted while any other read-lock is held. In that
+  ** case no checkpoint may have run since the snapshot was taken either,
+  ** so the frames in the old log that were not part of the snapshot were
+  ** never backfilled, and so there cannot have been any.  */
+  if( memcmp(hdr.aSalt, pWal->hdr.aSalt, sizeof(hdr.aSalt)) ){
+    assert( pWal->readLock==0 );
+    iFirst = 1;
+  }else{
+    iFirst = hdr.mxFrame+1;
+  }
+  for(iFrame=iFirst; rc==SQLITE_OK && iFrame<=pWal->hdr.mxFrame; iFrame++){
+    volatile u32 *pDummy;
+    u32 iPg;
+    rc = walIndexPage(pWal, walFramePage(iFrame), &pDummy);
+    if( rc!=SQLITE_OK ) break;
+    iPg = walFramePgno(pWal, iFrame);
+    if( iPg==1 ){
+      bPage1 = 1;
+    }else if( sqlite3BitvecTest(pRead, iPg) ){
+      rc = SQLITE_BUSY_SNAPSHOT;
+    }
+  }
+
+  /* A connection that was ignoring the log must now obtain a read-lock
+  ** that covers the frames written by the other transactions. Otherwise
+  ** the log might be restarted when this transaction's frames are written
+  ** before the other frames have been checkpointed.  */
+  if( rc==SQLITE_OK && pWal->readLock==0 ){
+    int cnt = 0;
+    walUnlockShared(pWal, WAL_READ_LOCK(0));
+    pWal->readLock = -1;
+    do{
+      rc = walTryBeginRead(pWal, &bChanged, 1, ++cnt);
+    }while( rc==WAL_RETRY );
+  }
+
+  for(iFrame=iFirst; rc==SQLITE_OK && iFrame<=pWal->hdr.mxFrame; iFrame++){
+    u32 iPg = walFramePgno(pWal, iFrame);
+    if( iPg!=1 ) rc = xUndo(pUndoCtx, iPg);
+  }
+  if( rc==SQLITE_OK && bPage1 ){
+    rc = xUndo(pUndoCtx, 1);
+  }
+
+  if( rc!=SQLITE_OK ){
+    memcpy(&pWal->hdr, &hdr, sizeof(WalIndexHdr));
+    walFilterRewind(pWal);
+    walUnlockExclusive(pWal, WAL_WRITE_LOCK, 1);
+    pWal->writeLock = 0;
+  }
+  return rc;
+}
+
 /*
 ** End a write transaction.  The commit has already been done.  This
 ** routine merely releases the lock.
@@ -2496,7 +2949,14 @@ int sqlite3WalEndWriteTransaction(Wal *pWal){
 */
 int sqlite3WalUndo(Wal *pWal, int (*xUndo)(void *, Pgno), void *pUndoCtx){
   int rc = SQLITE_OK;
-  if( ALWAYS(pWal->writeLock) ){
+
+  /* The caller holds the write lock, unless it is rolling back a
+  ** transaction opened by BEGIN CONCURRENT that has not yet taken it (see
+  ** sqlite3WalLockForCommit()). Such a transaction writes nothing to the
+  ** log before it takes the lock, as pagerStress() refuses to spill its
+  ** pages, so there are no frames to undo. Its dirty pages are discarded
+  ** by the caller.  */
+  if( pWal->writeLock ){
     Pgno iMax = pWal->hdr.mxFrame;
     Pgno iFrame;
   
@@ -2524,6 +2984,7 @@ int sqlite3WalUndo(Wal *pWal, int (*xUndo)(void *, Pgno), void *pUndoCtx){
       rc = xUndo(pUndoCtx, walFramePgno(pWal, iFrame));
     }
     if( iMax!=pWal->hdr.mxFrame ) walCleanupHash(pWal);
+    walFilterRewind(pWal);
   }
   assert( rc==SQLITE_OK );
   return rc;
@@ -2536,7 +2997,11 @@ int sqlite3WalUndo(Wal *pWal, int (*xUndo)(void *, Pgno), void *pUndoCtx){
 ** point in the event of a savepoint rollback (via WalSavepointUndo()).
 */
 void sqlite3WalSavepoint(Wal *pWal, u32 *aWalData){
-  assert( pWal->writeLock );
+  /* A transaction opened by BEGIN CONCURRENT opens savepoints before it
+  ** takes the write lock. It has not written any frames, so the values
+  ** saved describe the end of its snapshot, and sqlite3WalSavepointUndo()
+  ** will find nothing to undo.  */
+  assert( pWal->writeLock || pWal->readLock>=0 );
   aWalData[0] = pWal->hdr.mxFrame;
   aWalData[1] = pWal->hdr.aFrameCksum[0];
   aWalData[2] = pWal->hdr.aFrameCksum[1];
@@ -2552,7 +3017,8 @@ void sqlite3WalSavepoint(Wal *pWal, u32 *aWalData){
 int sqlite3WalSavepointUndo(Wal *pWal, u32 *aWalData){
   int rc = SQLITE_OK;
 
-  assert( pWal->writeLock );
+  assert( pWal->writeLock
+       || (aWalData[0]==pWal->hdr.mxFrame && aWalData[3]==pWal->nCkpt) );
   assert( aWalData[3]!=pWal->nCkpt || aWalData[0]<=pWal->hdr.mxFrame );
 
   if( aWalData[3]!=pWal->nCkpt ){
@@ -2569,6 +3035,7 @@ int sqlite3WalSavepointUndo(Wal *pWal, u32 *aWalData){
     pWal->hdr.aFrameCksum[0] = aWalData[1];
     pWal->hdr.aFrameCksum[1] = aWalData[2];
     walCleanupHash(pWal);
+    walFilterRewind(pWal);
   }
 
   return rc;
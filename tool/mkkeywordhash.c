@@ -37,12 +37,11 @@ struct Keyword {
   char *zTokenType;    /* Token value for this keyword */
   int mask;            /* Code this keyword if non-zero */
   int id;              /* Unique ID for this record */
-  int hash;            /* Hash on the keyword */
+  unsigned int hash;   /* Hash on the keyword */
   int offset;          /* Offset to start of name string */
   int len;             /* Length of this keyword, not counting final \000 */
   int prefix;          /* Number of characters in prefix */
   int longestSuffix;   /* Longest suffix that is a prefix on another word */
-  int iNext;           /* Index in aKeywordTable[] of next with same hash */
   int substrId;        /* Id to another keyword this keyword is embedded in */
   int substrOffset;    /* Offset into substrId for start of this keyword */
   char zOrigName[20];  /* Original keyword name before processing */
@@ -166,6 +165,7 @@ static Keyword aKeywordTable[] = {
   { "COLLATE",          "TK_COLLATE",      ALWAYS                 },
   { "COLUMN",           "TK_COLUMNKW",     ALTER                  },
   { "COMMIT",           "TK_COMMIT",       ALWAYS                 },
+  { "CONCURRENT",       "TK_CONCURRENT",   ALWAYS                 },
   { "CONFLICT",         "TK_CONFLICT",     CONFLICT               },
   { "CONSTRAINT",       "TK_CONSTRAINT",   ALWAYS                 },
   { "CREATE",           "TK_CREATE",       ALWAYS                 },
@@ -291,6 +291,19 @@ const unsigned char sqlite3UpperToLower[] = {
 };
 #define UpperToLower sqlite3UpperToLower
 
+/*
+** The hash of a keyword. The generated keywordCode() routine computes
+** the same hash of each identifier.
+*/
+static unsigned int keywordHash(const char *z, int n){
+  unsigned int h = 0;
+  int i;
+  for(i=0; i<n; i++){
+    h = (h ^ UpperToLower[(unsigned char)z[i]]) * 0x9e3779b1;
+  }
+  return h ^ (h>>16);
+}
+
 /*
 ** Comparision function for two Keyword records
 */
@@ -323,6 +336,56 @@ static int keywordCompare3(const void *a, const void *b){
   return n;
 }
 
+/*
+** Try to build a perfect hash of all keywords with nBucket buckets and
+** nSlot slots. The hash of each keyword selects a bucket. The slot of the
+** keyword is then:
+**
+**     ((hash / nBucket) ^ aDisp[hash % nBucket]) % nSlot
+**
+** Buckets are assigned displacements from largest to smallest, choosing
+** for each the smallest displacement that does not place any two
+** keywords in the same slot. If successful, fill in aDisp[] and set
+** aHash[] to one more than the index of the keyword in each slot, or
+** zero for an empty slot, and return 1. Otherwise return 0.
+*/
+static int perfectHash(int nBucket, int nSlot, int *aDisp, int *aHash){
+  int aSize[1000];     /* Number of keywords in each bucket */
+  int aSlot[20];       /* Slots of the keywords of one bucket */
+  int i, j, k, n, d;
+
+  for(i=0; i<nBucket; i++) aSize[i] = aDisp[i] = 0;
+  for(i=0; i<nSlot; i++) aHash[i] = 0;
+  for(i=0; i<nKeyword; i++) aSize[aKeywordTable[i].hash % nBucket]++;
+  for(n=nKeyword; n>0; n--){
+    for(i=0; i<nBucket; i++){
+      if( aSize[i]!=n ) continue;
+      if( n>sizeof(aSlot)/sizeof(aSlot[0]) ) return 0;
+      for(d=0; d<256; d++){
+        for(j=k=0; j<nKeyword && k<n; j++){
+          unsigned int h = aKeywordTable[j].hash;
+          int iSlot, x;
+          if( h % nBucket!=i ) continue;
+          iSlot = ((h / nBucket) ^ d) % nSlot;
+          if( aHash[iSlot] ) break;
+          for(x=0; x<k && aSlot[x]!=iSlot; x++){}
+          if( x<k ) break;
+          aSlot[k++] = iSlot;
+        }
+        if( k==n ) break;
+      }
+      if( d==256 ) return 0;
+      aDisp[i] = d;
+      for(j=k=0; j<nKeyword; j++){
+        if( aKeywordTable[j].hash % nBucket==i ){
+          aHash[aSlot[k++]] = j+1;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
 /*
 ** Return a KeywordTable entry with the given id
 */
@@ -339,12 +402,13 @@ static Keyword *findById(int id){
 ** output.
 */
 int main(int argc, char **argv){
-  int i, j, k, h;
-  int bestSize, bestCount;
-  int count;
+  int i, j, k;
+  int nBucket, nSlot;
   int nChar;
+  int nMaxLen = 0;
   int totalLen = 0;
   int aHash[1000];  /* 1000 is much bigger than nKeyword */
+  int aDisp[1000];
   char zText[2000];
 
   /* Remove entries from the list of keywords that have mask==0 */
@@ -364,8 +428,9 @@ int main(int argc, char **argv){
     assert( p->len<sizeof(p->zOrigName) );
     strcpy(p->zOrigName, p->zName);
     totalLen += p->len;
-    p->hash = (UpperToLower[(int)p->zName[0]]*4) ^
-              (UpperToLower[(int)p->zName[p->len-1]]*3) ^ p->len;
+    assert( p->zName[0]!='X' );  /* sqlite3GetToken() assumes this */
+    p->hash = keywordHash(p->zName, p->len);
+    if( p->len>nMaxLen ) nMaxLen = p->len;
     p->id = i+1;
   }
 
@@ -444,35 +509,22 @@ int main(int argc, char **argv){
   /* Sort the table by offset */
   qsort(aKeywordTable, nKeyword, sizeof(aKeywordTable[0]), keywordCompare3);
 
-  /* Figure out how big to make the hash table in order to minimize the
-  ** number of collisions */
-  bestSize = nKeyword;
-  bestCount = nKeyword*nKeyword;
-  for(i=nKeyword/2; i<=2*nKeyword; i++){
-    for(j=0; j<i; j++) aHash[j] = 0;
-    for(j=0; j<nKeyword; j++){
-      h = aKeywordTable[j].hash % i;
-      aHash[h] *= 2;
-      aHash[h]++;
-    }
-    for(j=count=0; j<i; j++) count += aHash[j];
-    if( count<bestCount ){
-      bestCount = count;
-      bestSize = i;
+  /* Find the smallest hash table, and for that the smallest number of
+  ** buckets, for which a perfect hash exists. */
+  for(nSlot=nKeyword; nSlot<2*nKeyword; nSlot++){
+    for(nBucket=nKeyword/4+1; nBucket<=nKeyword; nBucket++){
+      if( perfectHash(nBucket, nSlot, aDisp, aHash) ) break;
     }
+    if( nBucket<=nKeyword ) break;
   }
-
-  /* Compute the hash */
-  for(i=0; i<bestSize; i++) aHash[i] = 0;
-  for(i=0; i<nKeyword; i++){
-    h = aKeywordTable[i].hash % bestSize;
-    aKeywordTable[i].iNext = aHash[h];
-    aHash[h] = i+1;
+  if( nSlot>=2*nKeyword ){
+    fprintf(stderr, "cannot find a perfect hash for the keywords\n");
+    exit(1);
   }
 
   /* Begin generating code */
   printf("%s", zHdr);
-  printf("/* Hash score: %d */\n", bestCount);
+  printf("/* Hash: %d buckets, %d slots */\n", nBucket, nSlot);
   printf("static int keywordCode(const char *z, int n){\n");
   printf("  /* zText[] encodes %d bytes of keywords in %d bytes */\n",
           totalLen + nKeyword, nChar+1 );
@@ -515,10 +567,10 @@ int main(int argc, char **argv){
   if( j>0 ) printf("\n");
   printf("  };\n");
 
-  printf("  static const unsigned char aHash[%d] = {\n", bestSize);
-  for(i=j=0; i<bestSize; i++){
+  printf("  static const unsigned char aDisp[%d] = {\n", nBucket);
+  for(i=j=0; i<nBucket; i++){
     if( j==0 ) printf("    ");
-    printf(" %3d,", aHash[i]);
+    printf(" %3d,", aDisp[i]);
     j++;
     if( j>12 ){
       printf("\n");
@@ -527,10 +579,10 @@ int main(int argc, char **argv){
   }
   printf("%s  };\n", j==0 ? "" : "\n");    
 
-  printf("  static const unsigned char aNext[%d] = {\n", nKeyword);
-  for(i=j=0; i<nKeyword; i++){
+  printf("  static const unsigned char aHash[%d] = {\n", nSlot);
+  for(i=j=0; i<nSlot; i++){
     if( j==0 ) printf("    ");
-    printf(" %3d,", aKeywordTable[i].iNext);
+    printf(" %3d,", aHash[i]);
     j++;
     if( j>12 ){
       printf("\n");
@@ -576,20 +628,22 @@ int main(int argc, char **argv){
   }
   printf("%s  };\n", j==0 ? "" : "\n");
 
-  printf("  int h, i;\n");
-  printf("  if( n<2 ) return TK_ID;\n");
-  printf("  h = ((charMap(z[0])*4) ^\n"
-         "      (charMap(z[n-1])*3) ^\n"
-         "      n) %% %d;\n", bestSize);
-  printf("  for(i=((int)aHash[h])-1; i>=0; i=((int)aNext[i])-1){\n");
-  printf("    if( aLen[i]==n &&"
+  printf("  unsigned int h = 0;\n");
+  printf("  int i;\n");
+  printf("  if( n<2 || n>%d ) return TK_ID;\n", nMaxLen);
+  printf("  for(i=0; i<n; i++){\n");
+  printf("    h = (h ^ charMap(z[i])) * 0x9e3779b1;\n");
+  printf("  }\n");
+  printf("  h ^= h>>16;\n");
+  printf("  i = ((int)aHash[((h/%d) ^ aDisp[h%%%d]) %% %d])-1;\n",
+         nBucket, nBucket, nSlot);
+  printf("  if( i>=0 && aLen[i]==n &&"
                    " sqlite3StrNICmp(&zText[aOffset[i]],z,n)==0 ){\n");
   for(i=0; i<nKeyword; i++){
-    printf("      testcase( i==%d ); /* %s */\n",
+    printf("    testcase( i==%d ); /* %s */\n",
            i, aKeywordTable[i].zOrigName);
   }
-  printf("      return aCode[i];\n");
-  printf("    }\n");
+  printf("    return aCode[i];\n");
   printf("  }\n");
   printf("  return TK_ID;\n");
   printf("}\n");